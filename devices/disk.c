@@ -6,7 +6,10 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -28,10 +31,28 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, for DMA. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error. */
+#define BM_STA_INTR 0x04        /* Interrupt. */
+
+/* PCI configuration space access. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +68,38 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* A physical region descriptor: one piece of the memory a DMA
+   transfer moves data to or from. */
+struct prd {
+	uint32_t addr;              /* Physical address. */
+	uint16_t size;              /* Byte count, 0 means 64 kB. */
+	uint16_t flags;             /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000
+#define PRD_MAX (PGSIZE / sizeof (struct prd))
+
+/* Use bus master DMA instead of PIO where possible?  Set by the
+   -dma kernel command line option. */
+bool disk_use_dma;
+
+/* Most sectors moved per interrupt by READ/WRITE MULTIPLE.  A
+   command moves at most DISK_REQUEST_MAX sectors. */
+#define MULTIPLE_MAX 16
+
+/* Most requests merged into one command. */
+#define MERGE_MAX 32
+
+/* Ticks a request may wait in the queue before it is served ahead
+   of the elevator order.  Readers are usually waiting on the
+   result; writers usually are not. */
+#define READ_DEADLINE (TIMER_FREQ / 10)
+#define WRITE_DEADLINE (TIMER_FREQ)
 
 /* An ATA device. */
 struct disk {
@@ -56,6 +109,10 @@ struct disk {
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+	int multiple;               /* Sectors per interrupt in READ/WRITE
+	                               MULTIPLE, 0 if unsupported. */
+	bool dma;                   /* Transfer by bus master DMA? */
+	int plug_cnt;               /* Requests held back while nonzero. */
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
@@ -68,11 +125,23 @@ struct channel {
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
+	struct lock lock;           /* Protects the request queue. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	/* Once disk_init() returns, only the worker thread touches the
+	   controller; everyone else queues requests for it. */
+	struct list queue;          /* Pending disk_requests. */
+	struct condition queue_cond;    /* Signaled when QUEUE may be served. */
+	uint64_t head;              /* Elevator position, see req_pos(). */
+	long long request_cnt;      /* Requests served. */
+	long long command_cnt;      /* Commands issued for them. */
+	int64_t busy_ticks;         /* Ticks the worker spent with work queued. */
+
+	uint16_t bm_base;           /* Bus master base port, 0 if no DMA. */
+	struct prd *prdt;           /* PRD table, if BM_BASE is set. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
@@ -83,8 +152,16 @@ static struct channel channels[CHANNEL_CNT];
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
+static void set_multiple_mode (struct disk *, int max);
+static uint16_t find_bus_master (void);
+static bool can_dma (const struct disk *, const void *buffer);
+static void dma_transfer (struct disk_request **run, size_t cnt);
+static void pio_transfer (struct disk_request **run, size_t cnt);
+
+static void channel_worker (void *channel);
+static size_t pick_run (struct channel *, struct disk_request **run);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sectors (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -100,6 +177,13 @@ static void interrupt_handler (struct intr_frame *);
 void
 disk_init (void) {
 	size_t chan_no;
+	uint16_t bm_base = 0;
+
+	if (disk_use_dma) {
+		bm_base = find_bus_master ();
+		if (bm_base == 0)
+			printf ("disk: no bus master IDE controller, using PIO\n");
+	}
 
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
 		struct channel *c = &channels[chan_no];
@@ -122,6 +206,13 @@ disk_init (void) {
 		lock_init (&c->lock);
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
+		list_init (&c->queue);
+		cond_init (&c->queue_cond);
+		c->head = 0;
+		c->request_cnt = c->command_cnt = 0;
+		c->busy_ticks = 0;
+		c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
+		c->prdt = bm_base != 0 ? palloc_get_page (PAL_ASSERT | PAL_ZERO) : NULL;
 
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -132,6 +223,9 @@ disk_init (void) {
 
 			d->is_ata = false;
 			d->capacity = 0;
+			d->multiple = 0;
+			d->dma = false;
+			d->plug_cnt = 0;
 
 			d->read_cnt = d->write_cnt = 0;
 		}
@@ -150,6 +244,14 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* Hand the channel over to its worker. */
+		if (c->devices[0].is_ata || c->devices[1].is_ata) {
+			char name[16];
+			snprintf (name, sizeof name, "%s-io", c->name);
+			if (thread_create (name, PRI_MAX, channel_worker, c) == TID_ERROR)
+				PANIC ("%s: worker creation failed", c->name);
+		}
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
@@ -170,6 +272,12 @@ disk_print_stats (void) {
 				printf ("%s: %lld reads, %lld writes\n",
 						d->name, d->read_cnt, d->write_cnt);
 		}
+		if (channels[chan_no].request_cnt > 0)
+			printf ("%s: %lld requests in %lld commands, "
+					"busy %"PRId64" of %"PRId64" ticks\n",
+					channels[chan_no].name, channels[chan_no].request_cnt,
+					channels[chan_no].command_cnt,
+					channels[chan_no].busy_ticks, timer_ticks ());
 	}
 }
 
@@ -209,49 +317,331 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	// printf("disk read sec_no: %d buffer: %p\n", sec_no, buffer);
-	struct channel *c;
+	disk_read_multi (d, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_write_multi (d, sec_no, 1, buffer);
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * DISK_SECTOR_SIZE bytes.  Issues
+   one command per DISK_REQUEST_MAX sectors rather than one per
+   sector, moving several sectors per interrupt if D supports READ
+   MULTIPLE.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multi (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *buffer_) {
+	uint8_t *buffer = buffer_;
 
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
 
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	while (cnt > 0) {
+		size_t chunk = cnt < DISK_REQUEST_MAX ? cnt : DISK_REQUEST_MAX;
+		struct disk_request r;
+
+		disk_request_init (&r, d, sec_no, chunk, buffer, false);
+		disk_submit (&r);
+		disk_wait (&r);
+
+		sec_no += chunk;
+		buffer += chunk * DISK_SECTOR_SIZE;
+		cnt -= chunk;
+	}
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   DISK_SECTOR_SIZE bytes.  Returns after the disk has
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * DISK_SECTOR_SIZE bytes, as
+   disk_read_multi() reads them.  Returns after the disk has
    acknowledged receiving the data.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 void
-disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
-	// printf("disk write sec_no: %d buffer: %p\n", sec_no, buffer);
-	struct channel *c;
+disk_write_multi (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		const void *buffer_) {
+	const uint8_t *buffer = buffer_;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	while (cnt > 0) {
+		size_t chunk = cnt < DISK_REQUEST_MAX ? cnt : DISK_REQUEST_MAX;
+		struct disk_request r;
+
+		disk_request_init (&r, d, sec_no, chunk, (void *) buffer, true);
+		disk_submit (&r);
+		disk_wait (&r);
 
+		sec_no += chunk;
+		buffer += chunk * DISK_SECTOR_SIZE;
+		cnt -= chunk;
+	}
+}
+
+/* Initializes R as a request to move CNT sectors, between 1 and
+   DISK_REQUEST_MAX, starting at SEC_NO between disk D and BUFFER.
+   Reads into BUFFER if WRITE is false, writes from it otherwise.
+   The caller may set R's CALLBACK and AUX before submitting it. */
+void
+disk_request_init (struct disk_request *r, struct disk *d,
+		disk_sector_t sec_no, size_t cnt, void *buffer, bool write) {
+	ASSERT (r != NULL);
 	ASSERT (d != NULL);
 	ASSERT (buffer != NULL);
+	ASSERT (cnt >= 1 && cnt <= DISK_REQUEST_MAX);
+
+	r->disk = d;
+	r->sector = sec_no;
+	r->cnt = cnt;
+	r->buffer = buffer;
+	r->write = write;
+	r->callback = NULL;
+	r->aux = NULL;
+	sema_init (&r->done, 0);
+}
 
-	c = d->channel;
+/* Queues R for its disk's channel worker and returns at once.
+   When R completes, the worker calls R's CALLBACK if it has one,
+   and otherwise wakes up disk_wait().  R and its buffer must stay
+   put until then.  A request for sectors that overlap those of a
+   request submitted before it, where either one writes, is served
+   after that one; other requests may complete in any order. */
+void
+disk_submit (struct disk_request *r) {
+	struct channel *c = r->disk->channel;
+
+	r->deadline = timer_ticks () + (r->write ? WRITE_DEADLINE : READ_DEADLINE);
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	list_push_back (&c->queue, &r->elem);
+	cond_signal (&c->queue_cond, &c->lock);
 	lock_release (&c->lock);
 }
-
+
+/* Waits for R, which was submitted without a callback, to
+   complete. */
+void
+disk_wait (struct disk_request *r) {
+	ASSERT (r->callback == NULL);
+
+	sema_down (&r->done);
+}
+
+/* Holds back the requests for disk D submitted from now until the
+   matching disk_unplug(), so that the worker sees them together
+   and can merge and order them.  Plugs nest. */
+void
+disk_plug (struct disk *d) {
+	struct channel *c = d->channel;
+
+	lock_acquire (&c->lock);
+	d->plug_cnt++;
+	lock_release (&c->lock);
+}
+
+/* Undoes a disk_plug() on D. */
+void
+disk_unplug (struct disk *d) {
+	struct channel *c = d->channel;
+
+	lock_acquire (&c->lock);
+	ASSERT (d->plug_cnt > 0);
+	if (--d->plug_cnt == 0)
+		cond_signal (&c->queue_cond, &c->lock);
+	lock_release (&c->lock);
+}
+
+/* Request scheduling. */
+
+/* Returns R's position in the elevator order of its channel:
+   master before slave, then by sector. */
+static uint64_t
+req_pos (const struct disk_request *r) {
+	return ((uint64_t) r->disk->dev_no << 32) | r->sector;
+}
+
+/* Returns true if C has a request the worker may serve, that is,
+   one for a disk that is not plugged. */
+static bool
+queue_ready (struct channel *c) {
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (r->disk->plug_cnt == 0)
+			return true;
+	}
+	return false;
+}
+
+/* Returns true if R, in C's queue, has to wait for a request queued
+   before it: one on the same disk, for overlapping sectors, where
+   either writes.  Serving R first would read stale data or let the
+   older write win.  Must be called with C's lock held. */
+static bool
+req_blocked (struct channel *c, const struct disk_request *r) {
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != &r->elem; e = list_next (e)) {
+		struct disk_request *q = list_entry (e, struct disk_request, elem);
+		if (q->disk == r->disk && (q->write || r->write)
+				&& q->sector < r->sector + r->cnt
+				&& r->sector < q->sector + q->cnt)
+			return true;
+	}
+	return false;
+}
+
+/* Returns a request in C's queue that R can be merged with: one on
+   the same disk in the same direction, ending right before R if
+   BEFORE is true, starting right after R otherwise.  Returns NULL
+   if there is none.  Must be called with C's lock held. */
+static struct disk_request *
+find_adjacent (struct channel *c, const struct disk_request *r, bool before) {
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *q = list_entry (e, struct disk_request, elem);
+		if (q->disk != r->disk || q->write != r->write)
+			continue;
+		if ((before ? q->sector + q->cnt == r->sector
+				: r->sector + r->cnt == q->sector) && !req_blocked (c, q))
+			return q;
+	}
+	return NULL;
+}
+
+/* Removes the requests the worker of C is to serve next from C's
+   queue, stores them in RUN in sector order and returns how many
+   there are.  They cover consecutive sectors of one disk in one
+   direction, at most DISK_REQUEST_MAX in total, so one command
+   moves them all.
+
+   A request that has waited past its deadline goes first.
+   Otherwise the elevator sweeps upward (C-LOOK): the next request
+   at or past the head position, or the lowest one once nothing is
+   left above the head.  Requests blocked by an earlier overlapping
+   one, see req_blocked(), are passed over.  The oldest request of
+   an unplugged disk never is, so there is always one to serve.
+   Must be called with C's lock held. */
+static size_t
+pick_run (struct channel *c, struct disk_request **run) {
+	struct disk_request *first = NULL, *above = NULL, *lowest = NULL, *r;
+	int64_t now = timer_ticks ();
+	struct list_elem *e;
+	size_t cnt, sectors;
+
+	ASSERT (lock_held_by_current_thread (&c->lock));
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		r = list_entry (e, struct disk_request, elem);
+		if (r->disk->plug_cnt > 0 || req_blocked (c, r))
+			continue;
+		if (r->deadline <= now
+				&& (first == NULL || r->deadline < first->deadline))
+			first = r;
+		if (req_pos (r) >= c->head
+				&& (above == NULL || req_pos (r) < req_pos (above)))
+			above = r;
+		if (lowest == NULL || req_pos (r) < req_pos (lowest))
+			lowest = r;
+	}
+	if (first == NULL)
+		first = above != NULL ? above : lowest;
+	ASSERT (first != NULL);
+
+	/* Start at the beginning of the stretch FIRST belongs to. */
+	for (cnt = 1; cnt < MERGE_MAX
+			&& (r = find_adjacent (c, first, true)) != NULL; cnt++)
+		first = r;
+
+	/* Take the stretch in order, as far as one command reaches. */
+	list_remove (&first->elem);
+	run[0] = first;
+	cnt = 1;
+	sectors = first->cnt;
+	while (cnt < MERGE_MAX
+			&& (r = find_adjacent (c, run[cnt - 1], false)) != NULL
+			&& sectors + r->cnt <= DISK_REQUEST_MAX) {
+		list_remove (&r->elem);
+		run[cnt++] = r;
+		sectors += r->cnt;
+	}
+
+	c->head = req_pos (first) + sectors;
+	return cnt;
+}
+
+/* Worker thread for CHANNEL_.  Serves the channel's queue one
+   command at a time and completes the requests each one covers.
+   The two channels' workers run independently, so transfers on
+   one channel overlap those on the other. */
+static void
+channel_worker (void *channel_) {
+	struct channel *c = channel_;
+	bool busy = false;
+	int64_t busy_since = 0;
+
+	for (;;) {
+		struct disk_request *run[MERGE_MAX];
+		size_t cnt, sectors = 0;
+		bool dma = true;
+		struct disk *d;
+
+		/* Account the time from picking up work until running out of
+		   it as busy. */
+		lock_acquire (&c->lock);
+		if (busy && !queue_ready (c)) {
+			c->busy_ticks += timer_elapsed (busy_since);
+			busy = false;
+		}
+		while (!queue_ready (c))
+			cond_wait (&c->queue_cond, &c->lock);
+		if (!busy) {
+			busy = true;
+			busy_since = timer_ticks ();
+		}
+		cnt = pick_run (c, run);
+		lock_release (&c->lock);
+
+		d = run[0]->disk;
+		for (size_t i = 0; i < cnt; i++) {
+			dma = dma && can_dma (d, run[i]->buffer);
+			sectors += run[i]->cnt;
+		}
+		if (dma)
+			dma_transfer (run, cnt);
+		else
+			pio_transfer (run, cnt);
+
+		if (run[0]->write)
+			d->write_cnt += sectors;
+		else
+			d->read_cnt += sectors;
+		c->request_cnt += cnt;
+		c->command_cnt++;
+
+		for (size_t i = 0; i < cnt; i++) {
+			struct disk_request *r = run[i];
+			if (r->callback != NULL)
+				r->callback (r);
+			else
+				sema_up (&r->done);
+		}
+	}
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -366,6 +756,13 @@ identify_ata_device (struct disk *d) {
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+	/* Word 47 gives the most sectors READ/WRITE MULTIPLE can move
+	   per interrupt. */
+	set_multiple_mode (d, id[47] & 0xff);
+
+	/* Word 49 bit 8 says whether the disk does DMA. */
+	d->dma = c->bm_base != 0 && (id[49] & 0x100) != 0;
+
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -384,6 +781,69 @@ identify_ata_device (struct disk *d) {
 	printf ("\"\n");
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D, moving as many sectors
+   per interrupt as possible but no more than MAX, the limit D
+   reported.  Leaves D's MULTIPLE member 0 if D does not support
+   it. */
+static void
+set_multiple_mode (struct disk *d, int max) {
+	struct channel *c = d->channel;
+	int multiple = 1;
+
+	if (max > MULTIPLE_MAX)
+		max = MULTIPLE_MAX;
+	if (max < 2)
+		return;
+
+	/* The block size must be a power of two. */
+	while (multiple * 2 <= max)
+		multiple *= 2;
+
+	select_device_wait (d);
+	outb (reg_nsect (c), multiple);
+	issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+	sema_down (&c->completion_wait);
+	wait_while_busy (d);
+	if ((inb (reg_status (c)) & STA_ERR) == 0)
+		d->multiple = multiple;
+}
+
+/* Looks for a PCI IDE controller that can be a bus master, enables
+   it to master the bus, and returns its bus master base port, or 0
+   if there is none. */
+static uint16_t
+find_bus_master (void) {
+	for (int dev = 0; dev < 32; dev++)
+		for (int fn = 0; fn < 8; fn++) {
+			uint32_t addr = 0x80000000 | (dev << 11) | (fn << 8);
+			uint32_t class, bar4, command;
+
+			outl (PCI_CONFIG_ADDR, addr);
+			if ((inl (PCI_CONFIG_DATA) & 0xffff) == 0xffff)
+				continue;
+
+			/* Mass storage, IDE, with bus mastering (prog-if bit 7). */
+			outl (PCI_CONFIG_ADDR, addr | 0x08);
+			class = inl (PCI_CONFIG_DATA);
+			if ((class >> 16) != 0x0101 || (class & 0x8000) == 0)
+				continue;
+
+			/* BAR4 is the bus master I/O port range. */
+			outl (PCI_CONFIG_ADDR, addr | 0x20);
+			bar4 = inl (PCI_CONFIG_DATA);
+			if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+				continue;
+
+			/* Enable I/O space and bus mastering. */
+			outl (PCI_CONFIG_ADDR, addr | 0x04);
+			command = inl (PCI_CONFIG_DATA);
+			outl (PCI_CONFIG_ADDR, addr | 0x04);
+			outl (PCI_CONFIG_DATA, (command & 0xffff) | 0x05);
+			return bar4 & 0xfffc;
+		}
+	return 0;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -404,17 +864,18 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT, between 1 and 256, to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sectors (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt >= 1 && cnt <= DISK_REQUEST_MAX);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt & 0xff);     /* 0 means 256. */
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -422,6 +883,130 @@ select_sector (struct disk *d, disk_sector_t sec_no) {
 			DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
 }
 
+/* Returns true if D can transfer to or from BUFFER by DMA.  The
+   controller needs the physical address of the buffer, which only
+   kernel memory has here, and it must be word aligned. */
+static bool
+can_dma (const struct disk *d, const void *buffer) {
+	return d->dma && is_kernel_vaddr (buffer)
+		&& ((uintptr_t) buffer & 1) == 0;
+}
+
+/* Returns the buffer for sector IDX of the run of CNT requests in
+   RUN, counting from the run's first sector. */
+static uint8_t *
+run_buffer (struct disk_request **run, size_t cnt, size_t idx) {
+	for (size_t i = 0; i < cnt; i++) {
+		if (idx < run[i]->cnt)
+			return (uint8_t *) run[i]->buffer + idx * DISK_SECTOR_SIZE;
+		idx -= run[i]->cnt;
+	}
+	NOT_REACHED ();
+}
+
+/* Carries out the run of CNT requests in RUN, as returned by
+   pick_run(), as one bus master DMA command.  The controller is
+   told where each page of each request's buffer lies through the
+   channel's PRD table, and the worker sleeps until the transfer is
+   done. */
+static void
+dma_transfer (struct disk_request **run, size_t cnt) {
+	struct disk *d = run[0]->disk;
+	struct channel *c = d->channel;
+	bool write = run[0]->write;
+	uint8_t dir = write ? 0 : BM_CMD_READ;
+	size_t prd_cnt = 0, sectors = 0;
+	uint8_t bm_status;
+
+	/* One region per page, so none crosses a 64 kB boundary. */
+	for (size_t i = 0; i < cnt; i++) {
+		uint8_t *p = run[i]->buffer;
+		size_t left = run[i]->cnt * DISK_SECTOR_SIZE;
+
+		while (left > 0) {
+			size_t size = PGSIZE - pg_ofs (p);
+			if (size > left)
+				size = left;
+			ASSERT (prd_cnt < PRD_MAX);
+			ASSERT (vtop (p) + size <= UINT32_MAX);
+			c->prdt[prd_cnt].addr = vtop (p);
+			c->prdt[prd_cnt].size = size;
+			c->prdt[prd_cnt].flags = 0;
+			prd_cnt++;
+			p += size;
+			left -= size;
+		}
+		sectors += run[i]->cnt;
+	}
+	c->prdt[prd_cnt - 1].flags = PRD_EOT;
+
+	outl (reg_bm_prdt (c), vtop (c->prdt));
+	outb (reg_bm_command (c), dir);
+	outb (reg_bm_status (c),
+			inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+
+	select_sectors (d, run[0]->sector, sectors);
+	issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+	outb (reg_bm_command (c), dir | BM_CMD_START);
+	sema_down (&c->completion_wait);
+	outb (reg_bm_command (c), dir);
+
+	bm_status = inb (reg_bm_status (c));
+	outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+	if ((bm_status & BM_STA_ERR) != 0 || (inb (reg_status (c)) & STA_ERR) != 0)
+		PANIC ("%s: disk DMA %s failed, sector=%"PRDSNu,
+				d->name, write ? "write" : "read", run[0]->sector);
+}
+
+/* Carries out the run of CNT requests in RUN, as returned by
+   pick_run(), as one PIO command, moving several sectors per
+   interrupt if the disk supports READ/WRITE MULTIPLE. */
+static void
+pio_transfer (struct disk_request **run, size_t cnt) {
+	struct disk *d = run[0]->disk;
+	struct channel *c = d->channel;
+	disk_sector_t sec_no = run[0]->sector;
+	size_t block = d->multiple > 0 ? (size_t) d->multiple : 1;
+	size_t sectors = 0;
+
+	for (size_t i = 0; i < cnt; i++)
+		sectors += run[i]->cnt;
+
+	select_sectors (d, sec_no, sectors);
+	if (!run[0]->write) {
+		issue_pio_command (c, d->multiple > 0
+				? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+		for (size_t done = 0; done < sectors; ) {
+			size_t n = sectors - done < block ? sectors - done : block;
+
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu,
+						d->name, sec_no + (disk_sector_t) done);
+			for (size_t i = 0; i < n; i++, done++)
+				input_sector (c, run_buffer (run, cnt, done));
+		}
+	} else {
+		issue_pio_command (c, d->multiple > 0
+				? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+
+		/* The first block goes out as soon as the disk asks for it;
+		   each later one after the interrupt for the one before. */
+		for (size_t done = 0; done < sectors; ) {
+			size_t n = sectors - done < block ? sectors - done : block;
+
+			if (done > 0)
+				sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu,
+						d->name, sec_no + (disk_sector_t) done);
+			for (size_t i = 0; i < n; i++, done++)
+				output_sector (c, run_buffer (run, cnt, done));
+		}
+		sema_down (&c->completion_wait);
+	}
+}
+
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
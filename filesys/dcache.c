@@ -0,0 +1,235 @@
+/* dcache.c: Cache of directory entries for path resolution. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Maximum number of cached entries.  The least recently used entry
+ * makes room for a new one. */
+#define DCACHE_SIZE 256
+
+/* A cached name.  SECTOR is the inode sector NAME refers to in the
+ * directory whose inode is at PARENT, or DCACHE_NEGATIVE if that
+ * directory has no entry NAME. */
+struct dcache_entry {
+	disk_sector_t parent;
+	char name[NAME_MAX + 1];
+	disk_sector_t sector;
+	struct hash_elem hash_elem;         /* Element in dcache_map. */
+	struct list_elem lru_elem;          /* Element in dcache_lru. */
+};
+
+static struct hash dcache_map;          /* (parent, name) -> entry. */
+static struct list dcache_lru;          /* Most recently used first. */
+
+/* A lookup that misses reads the directory without DCACHE_LOCK and
+ * caches what it found only if the directory's generation did not
+ * change meanwhile, so that it never undoes a concurrent dir_add()
+ * or dir_remove().  Directories share the generations by sector; a
+ * collision only costs a lookup that is not cached. */
+#define DCACHE_GEN_CNT 64
+static unsigned dcache_gen[DCACHE_GEN_CNT];
+
+static struct lock dcache_lock;         /* Protects the above. */
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt;
+
+static uint64_t dcache_hash (const struct hash_elem *, void *);
+static bool dcache_less (const struct hash_elem *, const struct hash_elem *,
+		void *);
+static struct dcache_entry *dcache_find (disk_sector_t parent,
+		const char *name);
+static void dcache_store (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+static void dcache_evict (struct dcache_entry *);
+static unsigned *dcache_gen_of (disk_sector_t parent);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void) {
+	hash_init (&dcache_map, dcache_hash, dcache_less, NULL);
+	list_init (&dcache_lru);
+	lock_init (&dcache_lock);
+}
+
+/* Looks NAME up in the directory at PARENT.  Returns false if the
+ * cache does not know.  Otherwise returns true and sets *SECTORP to
+ * the entry's inode sector, or to DCACHE_NEGATIVE if the directory
+ * is known to have no such entry. */
+bool
+dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sectorp) {
+	struct dcache_entry *de;
+
+	lock_acquire (&dcache_lock);
+	de = dcache_find (parent, name);
+	if (de != NULL) {
+		hit_cnt++;
+		*sectorp = de->sector;
+		list_remove (&de->lru_elem);
+		list_push_front (&dcache_lru, &de->lru_elem);
+	} else
+		miss_cnt++;
+	lock_release (&dcache_lock);
+	return de != NULL;
+}
+
+/* Returns the generation of the directory at PARENT, to be passed
+ * to dcache_fill() after reading the directory. */
+unsigned
+dcache_generation (disk_sector_t parent) {
+	unsigned gen;
+
+	lock_acquire (&dcache_lock);
+	gen = *dcache_gen_of (parent);
+	lock_release (&dcache_lock);
+	return gen;
+}
+
+/* Records what a lookup read from the directory at PARENT: NAME
+ * refers to the inode at SECTOR, or does not exist if SECTOR is
+ * DCACHE_NEGATIVE.  Does nothing if the directory changed since
+ * dcache_generation() returned GEN. */
+void
+dcache_fill (disk_sector_t parent, const char *name, disk_sector_t sector,
+		unsigned gen) {
+	lock_acquire (&dcache_lock);
+	if (*dcache_gen_of (parent) == gen)
+		dcache_store (parent, name, sector);
+	lock_release (&dcache_lock);
+}
+
+/* Records that NAME was just added to the directory at PARENT,
+ * referring to the inode at SECTOR. */
+void
+dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector) {
+	lock_acquire (&dcache_lock);
+	++*dcache_gen_of (parent);
+	dcache_store (parent, name, sector);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets what is known about NAME in the directory at PARENT. */
+void
+dcache_invalidate (disk_sector_t parent, const char *name) {
+	struct dcache_entry *de;
+
+	lock_acquire (&dcache_lock);
+	++*dcache_gen_of (parent);
+	de = dcache_find (parent, name);
+	if (de != NULL)
+		dcache_evict (de);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets every entry of the directory at PARENT.  Used when the
+ * directory is removed, since its sector may be reused. */
+void
+dcache_purge_dir (disk_sector_t parent) {
+	struct list_elem *e;
+
+	lock_acquire (&dcache_lock);
+	++*dcache_gen_of (parent);
+	for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru);) {
+		struct dcache_entry *de = list_entry (e, struct dcache_entry, lru_elem);
+		e = list_next (e);
+		if (de->parent == parent)
+			dcache_evict (de);
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void) {
+	printf ("Dcache: %lld hits, %lld misses\n", hit_cnt, miss_cnt);
+}
+
+/* Returns the entry for NAME in the directory at PARENT, or a null
+ * pointer.  Must be called with DCACHE_LOCK held. */
+static struct dcache_entry *
+dcache_find (disk_sector_t parent, const char *name) {
+	struct dcache_entry key;
+	struct hash_elem *e;
+
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dcache_map, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dcache_entry, hash_elem) : NULL;
+}
+
+/* Records that NAME in the directory at PARENT refers to the inode
+ * at SECTOR, or does not exist if SECTOR is DCACHE_NEGATIVE.  Must
+ * be called with DCACHE_LOCK held. */
+static void
+dcache_store (disk_sector_t parent, const char *name,
+		disk_sector_t sector) {
+	struct dcache_entry *de;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	de = dcache_find (parent, name);
+	if (de != NULL) {
+		de->sector = sector;
+		list_remove (&de->lru_elem);
+		list_push_front (&dcache_lru, &de->lru_elem);
+		return;
+	}
+
+	if (hash_size (&dcache_map) >= DCACHE_SIZE)
+		dcache_evict (list_entry (list_back (&dcache_lru),
+					struct dcache_entry, lru_elem));
+	de = malloc (sizeof *de);
+	if (de != NULL) {
+		de->parent = parent;
+		strlcpy (de->name, name, sizeof de->name);
+		de->sector = sector;
+		hash_insert (&dcache_map, &de->hash_elem);
+		list_push_front (&dcache_lru, &de->lru_elem);
+	}
+}
+
+/* Returns the generation of the directory at PARENT.  Must be
+ * called with DCACHE_LOCK held. */
+static unsigned *
+dcache_gen_of (disk_sector_t parent) {
+	return &dcache_gen[hash_int (parent) % DCACHE_GEN_CNT];
+}
+
+/* Drops DE from the cache.  Must be called with DCACHE_LOCK held. */
+static void
+dcache_evict (struct dcache_entry *de) {
+	hash_delete (&dcache_map, &de->hash_elem);
+	list_remove (&de->lru_elem);
+	free (de);
+}
+
+static uint64_t
+dcache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dcache_entry *de =
+		hash_entry (e, struct dcache_entry, hash_elem);
+	return hash_string (de->name) ^ hash_int (de->parent);
+}
+
+static bool
+dcache_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	const struct dcache_entry *de_a =
+		hash_entry (a, struct dcache_entry, hash_elem);
+	const struct dcache_entry *de_b =
+		hash_entry (b, struct dcache_entry, hash_elem);
+	if (de_a->parent != de_b->parent)
+		return de_a->parent < de_b->parent;
+	return strcmp (de_a->name, de_b->name) < 0;
+}
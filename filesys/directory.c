@@ -1,7 +1,10 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -25,6 +28,39 @@ struct dir_entry {
 	
 };
 
+/* Big directories are hashed: the data holds buckets of one sector
+ * each, and a name lives in bucket hash(name) % (number of primary
+ * buckets), or in the overflow buckets chained to it.  Overflow
+ * buckets are appended to the data as they are needed.
+ * Directories whose inode records no buckets are flat arrays of
+ * entries, and are searched linearly.  Directories start flat, so
+ * that the many small ones take a single sector, and are rehashed
+ * by dir_add() once they hold DIR_FLAT_MAX entries. */
+#define DIR_BUCKET_ENTRIES \
+	((DISK_SECTOR_SIZE - sizeof (uint32_t)) / sizeof (struct dir_entry))
+
+/* Most entries of a flat directory, two sectors' worth. */
+#define DIR_FLAT_MAX (2 * DISK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Primary buckets of a hashed directory, at least. */
+#define DIR_BUCKET_CNT 8
+
+/* A directory bucket.  Must fit in DISK_SECTOR_SIZE bytes. */
+struct dir_bucket {
+	uint32_t next;                      /* Overflow bucket, 0 if none. */
+	struct dir_entry entries[DIR_BUCKET_ENTRIES];
+};
+
+/* Byte offset of entry SLOT of bucket IDX. */
+#define DIR_ENTRY_OFS(IDX, SLOT) \
+	((off_t) ((IDX) * DISK_SECTOR_SIZE + offsetof (struct dir_bucket, entries) \
+	          + (SLOT) * sizeof (struct dir_entry)))
+
+static bool hashed_lookup (const struct dir *, const char *name,
+		struct dir_entry *, off_t *);
+static bool hashed_add (struct dir *, const struct dir_entry *);
+static bool dir_rehash (struct dir *);
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -33,8 +69,24 @@ dir_create (disk_sector_t sector, size_t entry_cnt) {
 	if (sector == ROOT_DIR_SECTOR){
 		sector = cluster_to_sector(sector);
 	}
-	bool success = inode_create (sector, entry_cnt * sizeof (struct dir_entry), true);
+	// small directories start flat, see dir_rehash()
+	size_t bucket_cnt = 0;
+	if (entry_cnt > DIR_FLAT_MAX) {
+		bucket_cnt = DIV_ROUND_UP (entry_cnt, DIR_BUCKET_ENTRIES);
+		if (bucket_cnt < DIR_BUCKET_CNT)
+			bucket_cnt = DIR_BUCKET_CNT;
+	}
+	bool success = inode_create (sector, bucket_cnt != 0
+			? bucket_cnt * DISK_SECTOR_SIZE
+			: entry_cnt * sizeof (struct dir_entry), true);
 	// dir_open
+	if (success && bucket_cnt != 0) {
+		struct inode *inode = inode_open (sector);
+		if (inode == NULL)
+			return false;
+		inode_set_dir_buckets (inode, bucket_cnt);
+		inode_close (inode);
+	}
 	return success;
 }
 
@@ -102,6 +154,9 @@ lookup (const struct dir *dir, const char *name,
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	if (inode_get_dir_buckets (dir->inode) != 0)
+		return hashed_lookup (dir, name, ep, ofsp);
+
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -125,12 +180,26 @@ dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
 	// printf("dir lookup\n");
 	struct dir_entry e;
+	disk_sector_t parent, sector;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL)) {
-		*inode = inode_open (e.inode_sector);
+	parent = inode_get_inumber (dir->inode);
+
+	// the dcache answers repeated lookups without reading the directory
+	if (!dcache_lookup (parent, name, &sector)) {
+		// the generation is taken before the scan, so a dir_add or
+		// dir_remove that races with it keeps the result out of the cache
+		unsigned gen = dcache_generation (parent);
+		sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_NEGATIVE;
+		// a removed directory's sector may be reused, so do not remember it
+		if (!inode_is_removed (dir->inode))
+			dcache_fill (parent, name, sector, gen);
+	}
+
+	if (sector != DCACHE_NEGATIVE) {
+		*inode = inode_open (sector);
 	}
 	else {
 		*inode = NULL;
@@ -162,6 +231,27 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
+	// a full flat directory that is big enough is hashed from now on
+	if (inode_get_dir_buckets (dir->inode) == 0) {
+		size_t used = 0;
+		for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+				ofs += sizeof e)
+			if (e.in_use)
+				used++;
+		if (used >= DIR_FLAT_MAX && used * sizeof e == (size_t) ofs
+				&& !dir_rehash (dir))
+			goto done;
+	}
+
+	if (inode_get_dir_buckets (dir->inode) != 0) {
+		memset (&e, 0, sizeof e);
+		e.in_use = true;
+		strlcpy (e.name, name, sizeof e.name);
+		e.inode_sector = inode_sector;
+		success = hashed_add (dir, &e);
+		goto added;
+	}
+
 	/* Set OFS to offset of free slot.
 	 * If there are no free slots, then it will be set to the
 	 * current end-of-file.
@@ -180,6 +270,9 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	e.inode_sector = inode_sector;
 	// printf("inode_write at: %d\n", inode_write_at (dir->inode, &e, sizeof e, ofs));
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+added:
+	if (success)
+		dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
 	// printf("dir_add : %d\n", success);
 done:
 	
@@ -213,9 +306,12 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
 
 	/* Remove inode. */
 	inode_remove (inode);
+	if (inode_is_dir (inode))
+		dcache_purge_dir (e.inode_sector);
 	success = true;
 	// dir->is_removed = true;
 done:
@@ -229,8 +325,19 @@ done:
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	struct dir_entry e;
+	bool hashed = inode_get_dir_buckets (dir->inode) != 0;
 
-	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
+	for (;;) {
+		if (hashed) {
+			/* Step over bucket headers and the tail of each sector. */
+			off_t idx = dir->pos / DISK_SECTOR_SIZE;
+			if (dir->pos < DIR_ENTRY_OFS (idx, 0))
+				dir->pos = DIR_ENTRY_OFS (idx, 0);
+			else if (dir->pos >= DIR_ENTRY_OFS (idx, DIR_BUCKET_ENTRIES))
+				dir->pos = DIR_ENTRY_OFS (idx + 1, 0);
+		}
+		if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+			break;
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			if (strcmp(e.name, ".") == 0  || strcmp(e.name, "..") == 0) continue;
@@ -241,6 +348,134 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
 	return false;
 }
 
+/* Returns the primary bucket of NAME in directory DIR. */
+static uint32_t
+bucket_of (const struct dir *dir, const char *name) {
+	return hash_string (name) % inode_get_dir_buckets (dir->inode);
+}
+
+/* Reads bucket IDX of directory DIR into B.  Returns false if the
+ * bucket lies past the end of the directory. */
+static bool
+bucket_read (const struct dir *dir, uint32_t idx, struct dir_bucket *b) {
+	return inode_read_at (dir->inode, b, sizeof *b,
+			(off_t) idx * DISK_SECTOR_SIZE) == sizeof *b;
+}
+
+/* lookup() for a hashed directory: searches only the chain of
+ * buckets NAME hashes to. */
+static bool
+hashed_lookup (const struct dir *dir, const char *name,
+		struct dir_entry *ep, off_t *ofsp) {
+	struct dir_bucket *b = malloc (sizeof *b);
+	uint32_t idx = bucket_of (dir, name);
+	bool found = false;
+
+	if (b == NULL)
+		return false;
+	while (!found && bucket_read (dir, idx, b)) {
+		for (size_t i = 0; i < DIR_BUCKET_ENTRIES; i++) {
+			struct dir_entry *e = &b->entries[i];
+			if (e->in_use && !strcmp (name, e->name)) {
+				if (ep != NULL)
+					*ep = *e;
+				if (ofsp != NULL)
+					*ofsp = DIR_ENTRY_OFS (idx, i);
+				found = true;
+				break;
+			}
+		}
+		if ((idx = b->next) == 0)
+			break;
+	}
+	free (b);
+	return found;
+}
+
+/* Stores E in the first free slot of the chain of buckets its name
+ * hashes to, chaining a new overflow bucket if they are all full.
+ * Returns true if successful, false on failure. */
+static bool
+hashed_add (struct dir *dir, const struct dir_entry *e) {
+	struct dir_bucket *b = malloc (sizeof *b);
+	uint32_t idx = bucket_of (dir, e->name);
+	bool success = false;
+
+	if (b == NULL)
+		return false;
+	for (;;) {
+		if (!bucket_read (dir, idx, b))
+			goto done;
+		for (size_t i = 0; i < DIR_BUCKET_ENTRIES; i++)
+			if (!b->entries[i].in_use) {
+				off_t ofs = DIR_ENTRY_OFS (idx, i);
+				success = inode_write_at (dir->inode, e, sizeof *e, ofs)
+					== sizeof *e;
+				goto done;
+			}
+		if (b->next == 0)
+			break;
+		idx = b->next;
+	}
+
+	/* The chain is full: append a bucket holding E, then link it in. */
+	uint32_t new_idx = DIV_ROUND_UP (inode_length (dir->inode),
+			DISK_SECTOR_SIZE);
+	memset (b, 0, sizeof *b);
+	b->entries[0] = *e;
+	if (inode_write_at (dir->inode, b, sizeof *b,
+				(off_t) new_idx * DISK_SECTOR_SIZE) != sizeof *b)
+		goto done;
+	success = inode_write_at (dir->inode, &new_idx, sizeof new_idx,
+			(off_t) idx * DISK_SECTOR_SIZE) == sizeof new_idx;
+done:
+	free (b);
+	return success;
+}
+
+/* Turns flat directory DIR into a hashed one holding the same
+ * entries, with DIR_BUCKET_CNT primary buckets, or as many as
+ * cover the flat entries, so that none are left behind them.
+ * Returns true if successful, false on failure, leaving DIR as it
+ * was. */
+static bool
+dir_rehash (struct dir *dir) {
+	off_t length = inode_length (dir->inode);
+	size_t cnt = length / sizeof (struct dir_entry);
+	struct dir_entry *old = malloc (length);
+	struct dir_bucket *b = calloc (1, sizeof *b);
+	uint32_t bucket_cnt = DIV_ROUND_UP (length, DISK_SECTOR_SIZE);
+	bool success = false;
+
+	ASSERT (inode_get_dir_buckets (dir->inode) == 0);
+
+	if (bucket_cnt < DIR_BUCKET_CNT)
+		bucket_cnt = DIR_BUCKET_CNT;
+	if (old == NULL || b == NULL
+			|| inode_read_at (dir->inode, old, length, 0) != length)
+		goto done;
+
+	/* The buckets take the place of the flat entries. */
+	for (uint32_t idx = 0; idx < bucket_cnt; idx++)
+		if (inode_write_at (dir->inode, b, sizeof *b,
+					(off_t) idx * DISK_SECTOR_SIZE) != sizeof *b)
+			goto done;
+	inode_set_dir_buckets (dir->inode, bucket_cnt);
+	success = true;
+	for (size_t i = 0; i < cnt; i++)
+		if (old[i].in_use && !hashed_add (dir, &old[i]))
+			success = false;
+	if (!success) {
+		/* Put the flat entries back. */
+		inode_set_dir_buckets (dir->inode, 0);
+		inode_write_at (dir->inode, old, length, 0);
+	}
+done:
+	free (old);
+	free (b);
+	return success;
+}
+
 size_t dir_size() {
 	return sizeof(struct dir);
 }
@@ -3,6 +3,7 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include <bitmap.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -24,12 +25,17 @@ struct fat_fs {
 	disk_sector_t data_start;
 	cluster_t last_clst;
 	struct lock write_lock;
+	struct bitmap *used_map;  /* Clusters in use, mirrors FAT != 0. */
+	struct bitmap *dirty_map; /* FAT sectors changed since last written. */
+	bool boot_dirty;          /* Boot sector changed since last written? */
 };
 
 static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_used_map_init (void);
+static void fat_mark_dirty (cluster_t clst);
 
 void
 fat_init (void) {
@@ -57,60 +63,59 @@ fat_open (void) {
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
-	// Load FAT directly from the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
-	}
+	// Load FAT directly from the disk, in one go: the table is
+	// exactly fat_sectors sectors long
+	disk_read_multi (filesys_disk, fat_fs->bs.fat_start,
+			fat_fs->bs.fat_sectors, fat_fs->fat);
+	fat_used_map_init ();
+	bitmap_set_all (fat_fs->dirty_map, false);
 }
 
 void
 fat_close (void) {
-	// Write FAT boot sector
-	uint8_t *bounce = calloc (1, DISK_SECTOR_SIZE);
+	fat_flush ();
+}
+
+/* Writes the boot sector and the FAT sectors that changed since they
+ * were last written, a run of adjacent sectors per disk command.
+ * Each run is copied out under the FAT lock, so allocation goes on
+ * while the copy is on its way to disk. */
+#define FAT_FLUSH_RUN 8
+
+void
+fat_flush (void) {
+	uint8_t *bounce = calloc (FAT_FLUSH_RUN, DISK_SECTOR_SIZE);
 	if (bounce == NULL)
-		PANIC ("FAT close failed");
-	memcpy (bounce, &fat_fs->bs, sizeof (fat_fs->bs));
-	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
-	free (bounce);
+		PANIC ("FAT flush failed");
+
+	// Write FAT boot sector
+	if (fat_fs->boot_dirty) {
+		fat_fs->boot_dirty = false;
+		memcpy (bounce, &fat_fs->bs, sizeof (fat_fs->bs));
+		disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
+	}
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
+	// Write the changed part of the FAT
+	const uint8_t *buffer = (const uint8_t *) fat_fs->fat;
+	size_t i = 0;
+	while (i < fat_fs->bs.fat_sectors) {
+		lock_acquire (&fat_fs->write_lock);
+		i = bitmap_scan (fat_fs->dirty_map, i, 1, true);
+		if (i == BITMAP_ERROR) {
+			lock_release (&fat_fs->write_lock);
+			break;
 		}
+		size_t cnt = 0;
+		while (cnt < FAT_FLUSH_RUN && i + cnt < fat_fs->bs.fat_sectors
+				&& bitmap_test (fat_fs->dirty_map, i + cnt))
+			bitmap_reset (fat_fs->dirty_map, i + cnt++);
+		memcpy (bounce, buffer + i * DISK_SECTOR_SIZE, cnt * DISK_SECTOR_SIZE);
+		lock_release (&fat_fs->write_lock);
+
+		disk_write_multi (filesys_disk, fat_fs->bs.fat_start + i, cnt, bounce);
+		i += cnt;
 	}
+	free (bounce);
 }
 
 void
@@ -123,6 +128,11 @@ fat_create (void) {
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_used_map_init ();
+
+	// The whole table is new, so all of it has to reach the disk
+	bitmap_set_all (fat_fs->dirty_map, true);
+	fat_fs->boot_dirty = true;
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -148,6 +158,7 @@ fat_boot_create (void) {
 	    .fat_sectors = fat_sectors,
 	    .root_dir_cluster = ROOT_DIR_CLUSTER,
 	};
+	fat_fs->boot_dirty = true;
 }
 
 void
@@ -159,6 +170,29 @@ fat_fs_init (void) {
 	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
     lock_init(&fat_fs->write_lock);
 
+	bitmap_destroy (fat_fs->dirty_map);
+	fat_fs->dirty_map = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->dirty_map == NULL)
+		PANIC ("FAT dirty map creation failed");
+
+}
+
+/* (Re)builds the map of used clusters from the in-memory FAT.
+ * Cluster 0 and the FAT entries past the end of the disk are
+ * never handed out, so they are marked used. */
+static void
+fat_used_map_init (void) {
+	cluster_t last_clst = (fat_fs->bs.total_sectors - fat_fs->bs.fat_sectors) - 2;
+	size_t bit_cnt = fat_fs->fat_length;
+
+	bitmap_destroy (fat_fs->used_map);
+	fat_fs->used_map = bitmap_create (bit_cnt);
+	if (fat_fs->used_map == NULL)
+		PANIC ("FAT used map creation failed");
+
+	for (size_t clst = 0; clst < bit_cnt; clst++)
+		if (clst == 0 || clst > last_clst || fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->used_map, clst);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -173,36 +207,97 @@ fat_create_chain (cluster_t clst) {
 	/* TODO: Your code goes here. */
 	ASSERT(clst != EOChain);
 
-	cluster_t free_cluster;
+	if (clst == 0)
+		return fat_extend_chain(0, 1, NULL);
 
-	if (clst == 0) {
-		free_cluster = find_free_cluster();
-		
-		// ASSERT(free_cluster != 0);
-		if (free_cluster == 0) {
-			// error handling
-			return 0;
+	// find the end of the chain and grow it from there
+	cluster_t next_clst = clst;
+	while (fat_get(next_clst) != EOChain)
+		next_clst = fat_get(next_clst);
+	return fat_extend_chain(next_clst, 1, NULL);
+}
+
+/* Appends CNT clusters to the chain that ends at TAIL, or starts a
+ * new chain if TAIL is 0.  Clusters are taken in runs of adjacent
+ * free clusters, preferring one run that holds all CNT and one that
+ * continues right after TAIL, so the chain stays physically
+ * contiguous where the disk allows.  If CLUSTERS is not null, the
+ * new clusters are stored there in chain order.
+ * Returns the first new cluster, or 0 if there were not CNT free
+ * clusters, in which case nothing is allocated. */
+cluster_t
+fat_extend_chain (cluster_t tail, size_t cnt, cluster_t *clusters) {
+	struct bitmap *used_map = fat_fs->used_map;
+	size_t bit_cnt = bitmap_size (used_map);
+	cluster_t first = 0, prev = tail;
+	size_t got = 0;
+
+	ASSERT (tail != EOChain);
+	ASSERT (cnt > 0);
+
+	lock_acquire (&fat_fs->write_lock);
+	ASSERT (tail == 0 || fat_fs->fat[tail] == EOChain);
+
+	size_t hint = tail != 0 ? tail + 1 : fat_fs->last_clst;
+	if (hint >= bit_cnt)
+		hint = 1;
+	while (got < cnt) {
+		size_t want = cnt - got;
+		size_t idx = bitmap_scan (used_map, hint, want, false);
+		if (idx == BITMAP_ERROR)
+			idx = bitmap_scan (used_map, 1, want, false);
+		if (idx == BITMAP_ERROR) {
+			/* No run is long enough: take the next free run, however
+			 * short. */
+			idx = bitmap_scan (used_map, hint, 1, false);
+			if (idx == BITMAP_ERROR)
+				idx = bitmap_scan (used_map, 1, 1, false);
+			if (idx == BITMAP_ERROR)
+				break;
+			want = 1;
+			while (want < cnt - got && idx + want < bit_cnt
+					&& !bitmap_test (used_map, idx + want))
+				want++;
 		}
-		
-		fat_put(free_cluster, EOChain);
-		return free_cluster;
-	}
 
-	cluster_t next_clst = clst;
-	while (true) {
-		if (fat_get(next_clst) == EOChain) {
-			free_cluster = find_free_cluster();
-			if (free_cluster == 0) return 0;
-			
-			fat_put(next_clst, free_cluster);
-			fat_put(free_cluster, EOChain);
-			
-			return free_cluster;
+		for (size_t i = 0; i < want; i++) {
+			cluster_t clst = idx + i;
+			bitmap_mark (used_map, clst);
+			fat_fs->fat[clst] = EOChain;
+			fat_mark_dirty (clst);
+			if (prev != 0) {
+				fat_fs->fat[prev] = clst;
+				fat_mark_dirty (prev);
+			}
+			if (first == 0)
+				first = clst;
+			if (clusters != NULL)
+				clusters[got] = clst;
+			prev = clst;
+			got++;
 		}
-		next_clst = fat_get(next_clst);
+		hint = prev + 1 < bit_cnt ? prev + 1 : 1;
 	}
 
-	NOT_REACHED();
+	if (got < cnt) {
+		/* Out of space: give back what was taken. */
+		cluster_t clst = first;
+		while (clst != 0 && clst != EOChain) {
+			cluster_t next = fat_fs->fat[clst];
+			fat_fs->fat[clst] = 0;
+			bitmap_reset (used_map, clst);
+			fat_mark_dirty (clst);
+			clst = next;
+		}
+		if (tail != 0) {
+			fat_fs->fat[tail] = EOChain;
+			fat_mark_dirty (tail);
+		}
+		first = 0;
+	} else
+		fat_fs->last_clst = hint;
+	lock_release (&fat_fs->write_lock);
+	return first;
 }
 
 /* Remove the chain of clusters starting from CLST.
@@ -236,9 +331,19 @@ fat_put (cluster_t clst, cluster_t val) {
 	ASSERT(clst != 0); 
 
 	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->used_map, clst, val != 0);
+	fat_mark_dirty (clst);
 	lock_release(&fat_fs->write_lock);
 }
 
+/* Notes that the FAT sector holding CLST's entry has to be written
+ * back.  Must be called with the FAT lock held. */
+static void
+fat_mark_dirty (cluster_t clst) {
+	bitmap_mark (fat_fs->dirty_map,
+			clst * sizeof (cluster_t) / DISK_SECTOR_SIZE);
+}
+
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
@@ -258,37 +363,30 @@ cluster_to_sector (cluster_t clst) {
 }
 
 bool fat_allocate(size_t cnt, disk_sector_t *sectorp) {
-	cluster_t start_clst = fat_create_chain(0);
+	// every chain has at least one cluster, laid out in one run if possible
+	cluster_t start_clst = fat_extend_chain(0, cnt > 0 ? cnt : 1, NULL);
 
 	if (start_clst == 0) return false;
 
-	cluster_t clst = start_clst;
-
-	for (size_t i = 1; i < cnt; i++) {
-		clst = fat_create_chain(clst);
-		if (clst == 0) {
-			fat_remove_chain(start_clst, 0);
-			return false;
-		}
-	}
 	// data sector
 	*sectorp = cluster_to_sector(start_clst);
 	
 	return true;
 }
 
+/* Returns a free cluster, or 0 if the disk is full.  Searches the
+ * used map from where the last allocation left off, so consecutive
+ * allocations do not rescan the clusters handed out before. */
 cluster_t find_free_cluster() {
-
-	cluster_t last_clst = (fat_fs->bs.total_sectors - fat_fs->bs.fat_sectors) - 2;
-	
-	unsigned int *fat = fat_fs->fat;
-	for (cluster_t idx = 1; idx <= last_clst; idx++){
-		if (fat[idx] == 0) {
-			return idx;
-		}	
-	}
-	
-	return 0;
+	struct bitmap *used_map = fat_fs->used_map;
+	size_t start = fat_fs->last_clst;
+
+	if (start >= bitmap_size (used_map))
+		start = 1;
+	size_t idx = bitmap_scan (used_map, start, 1, false);
+	if (idx == BITMAP_ERROR)
+		idx = bitmap_scan (used_map, 1, 1, false);
+	return idx != BITMAP_ERROR ? idx : 0;
 }
 
 cluster_t sector_to_cluster(disk_sector_t sector) {
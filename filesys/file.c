@@ -8,8 +8,18 @@ struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	off_t ra_next;              /* Offset just past the last read. */
+	int ra_seq_cnt;             /* Number of back-to-back sequential reads. */
+	off_t ra_end;               /* Read-ahead has been issued up to here. */
 };
 
+/* Sequential reads needed before read-ahead starts, and how far
+ * ahead of the reader it runs. */
+#define READAHEAD_TRIGGER 2
+#define READAHEAD_WINDOW (8 * DISK_SECTOR_SIZE)
+
+static void file_readahead (struct file *, off_t start, off_t bytes_read);
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -75,6 +85,7 @@ file_read (struct file *file, void *buffer, off_t size) {
 	// printf("file read file: %p, buffer: %p, size: %d pos: %d\n", file, buffer, size, file->pos);
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
 	// printf("file read bytes read: %d\n", bytes_read);
+	file_readahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -86,7 +97,9 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	file_readahead (file, file_ofs, bytes_read);
+	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -165,3 +178,30 @@ file_tell (struct file *file) {
 	ASSERT (file != NULL);
 	return file->pos;
 }
+
+/* Notes that BYTES_READ bytes were read from FILE at START.  Once
+ * the reads look sequential, asks the inode to fetch the data past
+ * them in the background, keeping READAHEAD_WINDOW bytes ahead of
+ * the reader. */
+static void
+file_readahead (struct file *file, off_t start, off_t bytes_read) {
+	if (start == file->ra_next)
+		file->ra_seq_cnt++;
+	else {
+		file->ra_seq_cnt = 0;
+		file->ra_end = 0;
+	}
+	file->ra_next = start + bytes_read;
+
+	if (bytes_read == 0 || file->ra_seq_cnt < READAHEAD_TRIGGER)
+		return;
+
+	/* Top the window up once the reader has used half of it. */
+	off_t target = file->ra_next + READAHEAD_WINDOW;
+	if (file->ra_end - file->ra_next > READAHEAD_WINDOW / 2)
+		return;
+	if (file->ra_end < file->ra_next)
+		file->ra_end = file->ra_next;
+	inode_readahead (file->inode, file->ra_end, target - file->ra_end);
+	file->ra_end = target;
+}
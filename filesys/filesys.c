@@ -2,11 +2,13 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/fat.h"
+#include "filesys/page_cache.h"
 #include "devices/disk.h"
 #include "threads/thread.h"
 
@@ -29,8 +31,10 @@ filesys_init (bool format) {
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
 	inode_init ();
+	dcache_init ();
 	
 #ifdef EFILESYS
+	page_cache_init ();
 	fat_init ();
 
 	if (format)
@@ -54,6 +58,7 @@ void
 filesys_done (void) {
 	/* Original FS */
 #ifdef EFILESYS
+	page_cache_flush ();
 	fat_close ();
 #else
 	free_map_close ();
@@ -108,7 +113,7 @@ filesys_create (const char *name, off_t initial_size) {
 	
 
 	if (!success && inode_sector != 0)
-		fat_remove_chain(inode_sector, 0);
+		fat_remove_chain(sector_to_cluster(inode_sector), 0);
 	// if (!dir_lookup(dir, last_path, &inode)) {
 	// 	dir_close(dir);
 	// 	return false;
@@ -310,7 +315,7 @@ bool filesys_create_dir(const char *name) {
 		&& dir_add(sub_dir, "..", inode_get_inumber(dir_get_inode(prev_dir)))
 	);
 	if (!success && inode_sector != 0)
-		fat_remove_chain(inode_sector, 0);
+		fat_remove_chain(sector_to_cluster(inode_sector), 0);
 	inode_tag_dir(sub_inode);
 	// printf("inode is dir: subinode: %d\n", sub_inode->is_dir);
 	// printf("mkdir inode %p\n", sub_inode);
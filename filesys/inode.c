@@ -1,11 +1,14 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 // user addition
 #include "filesys/fat.h"
@@ -20,7 +23,8 @@ struct inode_disk {
 	off_t length;                       /* File size in bytes. */
 	bool is_dir;
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[124];               /* Not used. */
+	uint32_t dir_buckets;               /* Hashed directory buckets, 0: flat. */
+	uint32_t unused[123];               /* Not used. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -32,25 +36,49 @@ bytes_to_sectors (off_t size) {
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	bool loading;                       /* Being read in by its opener. */
+	bool closing;                       /* Being written back by its
+	                                       last closer. */
 	// user addition
 	bool is_dir;
 	// bool is_dir_removed;
 	bool is_symlink;
+	struct rwlock rwlock;               /* Shared by readers and
+	                                       overwrites, exclusive for
+	                                       writes that grow the file. */
+	struct lock extend_lock;            /* Serializes loading the
+	                                       cluster map. */
+	cluster_t *clusters;                /* Data clusters in file order. */
+	size_t cluster_cnt;                 /* Number of CLUSTERS in use. */
+	size_t cluster_cap;                 /* Capacity of CLUSTERS. */
+	bool cluster_map_loaded;            /* CLUSTERS holds the whole chain? */
 	//
 	struct inode_disk data;             /* Inode content. */
 };
 
+static bool cluster_map_load (struct inode *);
+static bool cluster_map_reserve (struct inode *, size_t cnt);
+static bool cluster_map_append (struct inode *, cluster_t);
+static bool inode_extend (struct inode *, size_t cnt);
+static void inode_trim (struct inode *);
+
+/* When a write appends to a file, the clusters it needs are rounded
+ * up to a multiple of this, so that a file written in small pieces
+ * still gets its clusters in contiguous runs.  The excess is given
+ * back when the last opener closes the file. */
+#define INODE_PREALLOC_CLUSTERS 16
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 
 	ASSERT (inode != NULL);
 
@@ -60,10 +88,7 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 	// if inode.data points to file
 	// inode->data.length = EOF
 	if (pos < inode->data.length) {
-		
-		// sector should bigger than fat sector
-		disk_sector_t sector = inode->data.start;
-		
+		size_t idx = pos / DISK_SECTOR_SIZE;
 
 		// disk[0] = FAT_BOOT
 		// fat table sector: disk[1] ~ disk[157] 
@@ -77,16 +102,10 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 		// fat table[1] <=> disk[159]
 		// fat table[20001] <=> disk[20159]
 
-
-		// clst become start clst of that data
-		cluster_t clst = sector_to_cluster(sector);
-
-		int sector_cnt = pos / DISK_SECTOR_SIZE;
-		while (sector_cnt > 0) {
-			clst = fat_get(clst);
-			sector_cnt--;
-		} 
-		return cluster_to_sector(clst);
+		// the chain is walked once, later lookups index the cluster map
+		if (!cluster_map_load (inode) || idx >= inode->cluster_cnt)
+			return -1;
+		return cluster_to_sector(inode->clusters[idx]);
 	}
 	
 	// pos is over EOF
@@ -94,14 +113,152 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 		return -1;
 } 
 
-/* List of open inodes, so that opening a single inode twice
+/* The cluster map of an inode is a copy of its data chain, kept by
+ * this file alone: the FAT layer knows nothing of it.  It stays
+ * current because, while an inode is open, its data chain changes
+ * only through inode_extend() and inode_trim(), and is removed only
+ * by the last inode_close().  Code that edits the data chain of an
+ * open inode with fat_create_chain(), fat_extend_chain() or
+ * fat_remove_chain() directly must update or drop the map itself. */
+
+/* Fills INODE's cluster map by walking its FAT chain, unless that
+ * was done already.  Returns false if out of memory.  Readers may
+ * get here together, so the walk happens under EXTEND_LOCK and the
+ * map is published only once it is complete. */
+static bool
+cluster_map_load (struct inode *inode) {
+	bool success = true;
+
+	if (inode->cluster_map_loaded)
+		return true;
+
+	lock_acquire (&inode->extend_lock);
+	if (!inode->cluster_map_loaded) {
+		cluster_t clst = sector_to_cluster (inode->data.start);
+		while (clst != 0 && clst != EOChain) {
+			if (!cluster_map_append (inode, clst)) {
+				free (inode->clusters);
+				inode->clusters = NULL;
+				inode->cluster_cnt = inode->cluster_cap = 0;
+				success = false;
+				break;
+			}
+			clst = fat_get (clst);
+		}
+		barrier ();
+		inode->cluster_map_loaded = success;
+	}
+	lock_release (&inode->extend_lock);
+	return success;
+}
+
+/* Makes room for CNT more clusters in INODE's cluster map.
+ * Returns false if out of memory. */
+static bool
+cluster_map_reserve (struct inode *inode, size_t cnt) {
+	if (inode->cluster_cnt + cnt > inode->cluster_cap) {
+		size_t cap = inode->cluster_cap ? inode->cluster_cap : 16;
+		while (cap < inode->cluster_cnt + cnt)
+			cap *= 2;
+		cluster_t *clusters = realloc (inode->clusters,
+				cap * sizeof *clusters);
+		if (clusters == NULL)
+			return false;
+		inode->clusters = clusters;
+		inode->cluster_cap = cap;
+	}
+	return true;
+}
+
+/* Adds CLST to the end of INODE's cluster map.  Returns false if
+ * out of memory. */
+static bool
+cluster_map_append (struct inode *inode, cluster_t clst) {
+	if (!cluster_map_reserve (inode, 1))
+		return false;
+	inode->clusters[inode->cluster_cnt++] = clst;
+	return true;
+}
+
+/* Appends CNT clusters to INODE's chain in as few runs as the disk
+ * allows, recording them in the cluster map.  Returns false if the
+ * disk or memory ran out, in which case nothing is allocated. */
+static bool
+inode_extend (struct inode *inode, size_t cnt) {
+	if (!cluster_map_reserve (inode, cnt))
+		return false;
+
+	cluster_t tail = inode->clusters[inode->cluster_cnt - 1];
+	if (fat_extend_chain (tail, cnt,
+				inode->clusters + inode->cluster_cnt) == 0)
+		return false;
+	inode->cluster_cnt += cnt;
+	return true;
+}
+
+/* Gives back the clusters preallocated past the end of INODE's
+ * data. */
+static void
+inode_trim (struct inode *inode) {
+	size_t keep = bytes_to_sectors (inode->data.length);
+
+	if (keep == 0)
+		keep = 1;
+	if (!inode->cluster_map_loaded || inode->cluster_cnt <= keep)
+		return;
+	fat_remove_chain (inode->clusters[keep], inode->clusters[keep - 1]);
+	fat_put (inode->clusters[keep - 1], EOChain);
+	inode->cluster_cnt = keep;
+}
+
+/* Open inodes by sector, so that opening a single inode twice
  * returns the same `struct inode'. */
-static struct list open_inodes;
+static struct hash open_inodes;
+
+/* Protects OPEN_INODES and the open counts and LOADING and CLOSING
+ * flags of its members.  The disk is never touched with it held:
+ * an inode is in OPEN_INODES while it is read in and written back,
+ * with the flag set, and whoever finds it meanwhile waits on
+ * OPEN_INODES_DONE. */
+static struct lock open_inodes_lock;
+static struct condition open_inodes_done;
+
+static uint64_t inode_hash (const struct hash_elem *, void *);
+static bool inode_less (const struct hash_elem *, const struct hash_elem *,
+		void *);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	hash_init (&open_inodes, inode_hash, inode_less, NULL);
+	lock_init (&open_inodes_lock);
+	cond_init (&open_inodes_done);
+}
+
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct inode *inode = hash_entry (e, struct inode, elem);
+	return hash_int (inode->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	const struct inode *inode_a = hash_entry (a, struct inode, elem);
+	const struct inode *inode_b = hash_entry (b, struct inode, elem);
+	return inode_a->sector < inode_b->sector;
+}
+
+/* Returns the number of inodes currently open. */
+size_t
+inode_open_count (void) {
+	return hash_size (&open_inodes);
+}
+
+/* Prints inode statistics. */
+void
+inode_print_stats (void) {
+	printf ("Inodes: %zu open\n", inode_open_count ());
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -137,7 +294,7 @@ inode_create (disk_sector_t sector, off_t length, bool is_dir) {
 			// fat[8] = -1		disk[176] = data 1024B to 1536B
 
 			// so disk inode become meta data for actual data
-			disk_write (filesys_disk, sector, disk_inode);
+			page_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 
 			// however, contents of data are not given
 			// initialize corressponding data sector with 0
@@ -147,7 +304,7 @@ inode_create (disk_sector_t sector, off_t length, bool is_dir) {
 				disk_sector_t data_sector = disk_inode->start;
 				cluster_t clst;
 				for (i = 0; i < sectors; i++) {
-					disk_write (filesys_disk, data_sector, zeros);
+					page_cache_write (data_sector, zeros, 0, DISK_SECTOR_SIZE);
 					clst = sector_to_cluster(data_sector);
 					
 					// find next sector 
@@ -173,43 +330,71 @@ inode_create (disk_sector_t sector, off_t length, bool is_dir) {
 struct inode *
 inode_open (disk_sector_t sector) {
 	// printf("inode open: sector %d\n", sector);
-	struct list_elem *e;
+	struct hash_elem *e;
 	struct inode *inode;
+	struct inode key;
 	
 	is_data_sector(sector);
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
+	/* Check whether this inode is already open.  One that is being
+	 * closed is gone once its closer is done, so look again then. */
+	lock_acquire (&open_inodes_lock);
+	key.sector = sector;
+	while ((e = hash_find (&open_inodes, &key.elem)) != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		if (inode->closing) {
+			cond_wait (&open_inodes_done, &open_inodes_lock);
+			continue;
 		}
+		inode->open_cnt++;
+		while (inode->loading)
+			cond_wait (&open_inodes_done, &open_inodes_lock);
+		lock_release (&open_inodes_lock);
+		return inode; 
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize.  Openers that find the inode before it is read in
+	 * wait for LOADING to clear. */
 	inode->sector = sector;
+	inode->loading = true;
+	inode->closing = false;
+	hash_insert (&open_inodes, &inode->elem);
 	inode->open_cnt = 1;
+	lock_release (&open_inodes_lock);
+
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	page_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
 	inode->is_dir = inode->data.is_dir;
 	inode->is_symlink = false;
+	inode->clusters = NULL;
+	inode->cluster_cnt = inode->cluster_cap = 0;
+	inode->cluster_map_loaded = false;
+	rwlock_init (&inode->rwlock);
+	lock_init (&inode->extend_lock);
+
+	lock_acquire (&open_inodes_lock);
+	inode->loading = false;
+	cond_broadcast (&open_inodes_done, &open_inodes_lock);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -229,23 +414,38 @@ inode_close (struct inode *inode) {
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
+	/* Release resources if this was the last opener.  The inode stays
+	 * in OPEN_INODES, marked CLOSING, until it is written back and its
+	 * blocks are freed, so that an opener that comes meanwhile waits
+	 * and then reads the latest copy. */
+	lock_acquire (&open_inodes_lock);
 	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
-		disk_write(filesys_disk, inode->sector, &inode->data);
+		inode->closing = true;
+		lock_release (&open_inodes_lock);
+
+		page_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
 		// printf("closeclose inode: %p sector: %d\n", inode, inode->sector);
 		/* Deallocate blocks if removed. */
-		if (inode->removed) {
+		if (!inode->removed)
+			inode_trim (inode);
+		else {
 			// inode					inode->sector = inode disk's location in disk
 			// inode disk = inode.data  inode->data.start = inode disk's data(file) start location in disk
 			// writing the data of disk
 			// removing fat chain
-			fat_remove_chain(inode->sector, 0);
-			fat_remove_chain(inode->data.start, 0);
+			fat_remove_chain(sector_to_cluster(inode->sector), 0);
+			fat_remove_chain(sector_to_cluster(inode->data.start), 0);
 		}
+
+		/* Remove from inode list and wake up who waits for it. */
+		lock_acquire (&open_inodes_lock);
+		hash_delete (&open_inodes, &inode->elem);
+		cond_broadcast (&open_inodes_done, &open_inodes_lock);
+		lock_release (&open_inodes_lock);
+		free (inode->clusters);
 		free (inode); 
-	}
+	} else
+		lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -264,12 +464,14 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	// printf("inode: %p, size: %d offset: %d\n", inode, size, offset);
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 	
+	rwlock_acquire_read (&inode->rwlock);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
 		int sector_ofs = offset % DISK_SECTOR_SIZE;
+		if (sector_idx == (disk_sector_t) -1)
+			break;
 
 		// to read the data at disk[secotr_idx] from sector_ofs
 
@@ -284,31 +486,47 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		/* Copy the chunk out of the page cache. */
+		page_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+	rwlock_release_read (&inode->rwlock);
 
 	return bytes_read;
 }
 
+/* Starts bringing the sectors that hold SIZE bytes of INODE from
+ * OFFSET into the page cache, without waiting for the disk.  Stops
+ * at the end of the file. */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t size) {
+	off_t end = offset + size;
+
+	/* The length is read under the lock, so it agrees with the
+	 * cluster map walked below. */
+	rwlock_acquire_read (&inode->rwlock);
+	if (end > inode_length (inode))
+		end = inode_length (inode);
+	if (offset < 0 || offset >= end) {
+		rwlock_release_read (&inode->rwlock);
+		return;
+	}
+
+	offset -= offset % DISK_SECTOR_SIZE;
+	for (; offset < end; offset += DISK_SECTOR_SIZE) {
+		disk_sector_t sector = byte_to_sector (inode, offset);
+		if (sector == (disk_sector_t) -1)
+			break;
+		page_cache_readahead_async (sector);
+	}
+	rwlock_release_read (&inode->rwlock);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
  * less than SIZE if end of file is reached or an error occurs.
@@ -321,10 +539,21 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	// if (inode_is_dir(inode)) return -1;
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
+
+	// overwrites share the lock with readers and with each other, the
+	// page cache keeps each sector consistent; a write that grows the
+	// file holds it exclusively, so nobody sees the new length before
+	// the data written there
+	bool extending = false;
+	rwlock_acquire_read (&inode->rwlock);
+	if (offset + size > inode->data.length) {
+		rwlock_release_read (&inode->rwlock);
+		rwlock_acquire_write (&inode->rwlock);
+		extending = true;
+	}
 	// there are two cases:
 	// first, from buffer write inode's data 	offset부터 size 만큼 EOF 전에 만족
 	// second, from buffer writhe inode's data 	offset부터 size 만큼 EOF 이후까지도
@@ -332,7 +561,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	// compare offset + size and inode's data length
 	
 	// write after EOF
-	if (offset + size > inode->data.length) {
+	if (extending && offset + size > inode->data.length) {
 		// example
 		// inode data length: 1000	현재 보유 sector: 2 (1024B)
 		// offset: 1200			
@@ -341,26 +570,41 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		// 450 => 1 sector
 		// cnt = 0 
 
-		size_t cnt = ((offset + size) - inode->data.length) / DISK_SECTOR_SIZE + 1;
-
-		// find last data sector
-		cluster_t last_cluster = traverse(sector_to_cluster(inode->data.start));
-		
-		static char zeros[DISK_SECTOR_SIZE];		
-
-		// sector_to_cluster
-		cluster_t new_cluster;
-		
-		for (size_t i = 0; i < cnt; i++) {
-			new_cluster = fat_create_chain(last_cluster);	
-			if (new_cluster == 0) {
-				// error handling
-				break;
-			}
-			disk_write(filesys_disk, cluster_to_sector(new_cluster), zeros);
-			last_cluster = new_cluster;
+		// only the clusters past the ones the inode already owns
+		if (!cluster_map_load (inode)) {
+			rwlock_release_write (&inode->rwlock);
+			return 0;
+		}
+		size_t cnt = bytes_to_sectors (offset + size);
+
+		// no reader is loading the cluster map under the write lock,
+		// so growing it needs no EXTEND_LOCK
+		if (inode->cluster_cnt < cnt) {
+			size_t need = cnt - inode->cluster_cnt;
+			size_t slack = ROUND_UP (cnt, INODE_PREALLOC_CLUSTERS) - cnt;
+
+			// take some slack too, falling back to exactly what is
+			// needed, then to whatever is left on the disk
+			if (!inode_extend (inode, need + slack)
+					&& (slack == 0 || !inode_extend (inode, need)))
+				while (inode->cluster_cnt < cnt && inode_extend (inode, 1))
+					continue;
 		}
-		inode->data.length += (offset + size) - inode->data.length;
+
+		// sectors entering the file are zeroed here, not at allocation,
+		// so preallocated clusters cost nothing until they are used
+		static char zeros[DISK_SECTOR_SIZE];
+		size_t old_cnt = bytes_to_sectors (inode->data.length);
+
+		// out of space: grow only as far as the clusters we got
+		off_t new_length = offset + size;
+		if ((size_t) new_length > inode->cluster_cnt * DISK_SECTOR_SIZE)
+			new_length = inode->cluster_cnt * DISK_SECTOR_SIZE;
+		for (size_t i = old_cnt; i < bytes_to_sectors (new_length); i++)
+			page_cache_write (cluster_to_sector (inode->clusters[i]), zeros,
+					0, DISK_SECTOR_SIZE);
+		if (new_length > inode->data.length)
+			inode->data.length = new_length;
 	}
 	// EOF이후 write를 위한 추가 할당 완료
 	
@@ -379,34 +623,21 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
 		if (chunk_size <= 0)
 			break;
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
 
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* Copy the chunk into the page cache, which reads in the
+		 * rest of the sector first if the chunk does not cover it. */
+		page_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
+	if (extending)
+		rwlock_release_write (&inode->rwlock);
+	else
+		rwlock_release_read (&inode->rwlock);
 	// printf("bytes written: %d\n", bytes_written);
 	return bytes_written;
 }
@@ -436,6 +667,20 @@ inode_length (const struct inode *inode) {
 	return inode->data.length;
 }
 
+/* Returns the number of hash buckets of directory INODE, or 0 if
+ * the directory is a flat array of entries. */
+uint32_t
+inode_get_dir_buckets (const struct inode *inode) {
+	return inode->data.dir_buckets;
+}
+
+/* Sets the number of hash buckets of directory INODE.  Written to
+ * disk along with the rest of the inode. */
+void
+inode_set_dir_buckets (struct inode *inode, uint32_t bucket_cnt) {
+	inode->data.dir_buckets = bucket_cnt;
+}
+
 bool inode_is_dir(const struct inode *inode) {
 	return inode->is_dir;
 }
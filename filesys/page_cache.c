@@ -1,9 +1,25 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/fat.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+#ifdef EFILESYS
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
+static void page_cache_kworkerd (void *aux);
+static void page_cache_readaheadd (void *aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations page_cache_op = {
@@ -14,11 +30,100 @@ static const struct page_operations page_cache_op = {
 };
 
 tid_t page_cache_workerd;
+tid_t page_cache_readahead_workerd;
+
+/* Number of sectors the cache holds, and the kernel pages
+ * backing them. */
+#define PAGE_CACHE_SIZE 64
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+#define PAGE_CACHE_PAGES (PAGE_CACHE_SIZE / SECTORS_PER_PAGE)
+
+/* The worker wakes up every PAGE_CACHE_FLUSH_INTERVAL ticks and
+ * writes back the slots that have been dirty for at least
+ * PAGE_CACHE_DIRTY_EXPIRE ticks. */
+#define PAGE_CACHE_FLUSH_INTERVAL (5 * TIMER_FREQ)
+#define PAGE_CACHE_DIRTY_EXPIRE (30 * TIMER_FREQ)
+
+/* Most adjacent sectors the read-ahead worker takes off its queue
+ * at once. */
+#define PAGE_CACHE_RUN SECTORS_PER_PAGE
+
+/* Most dirty slots a flush pins at once, so that misses meanwhile
+ * still find slots to recycle. */
+#define PAGE_CACHE_FLUSH_BATCH 16
+
+/* The worker also checkpoints the changed FAT sectors this often,
+ * right after writing back every dirty slot, so that the FAT never
+ * reaches the disk ahead of the data it points to. */
+#define FAT_CHECKPOINT_INTERVAL (30 * TIMER_FREQ)
+
+static struct page *slots[PAGE_CACHE_SIZE];
+static struct hash cache_map;           /* Cached sector -> slot. */
+static size_t clock_hand;               /* Next eviction candidate. */
+
+/* Protects CACHE_MAP, CLOCK_HAND and the sector and pin count of
+ * every slot.  May be held while acquiring an unpinned slot's
+ * lock, never the other way around. */
+static struct lock cache_lock;
+
+/* Signaled, with CACHE_LOCK held, whenever a slot is unpinned. */
+static struct condition slot_unpinned;
+
+/* Sectors waiting to be read ahead, in a ring.  Requests that do
+ * not fit are dropped; read-ahead is only a hint. */
+#define READAHEAD_QUEUE_SIZE 64
+static disk_sector_t readahead_queue[READAHEAD_QUEUE_SIZE];
+static size_t readahead_head, readahead_cnt;
+static struct lock readahead_lock;
+static struct condition readahead_cond;
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt, writeback_cnt, readahead_load_cnt;
+
+static uint64_t slot_hash (const struct hash_elem *e, void *aux);
+static bool slot_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux);
+static struct page *cache_get (disk_sector_t sector, bool load);
+static struct page *cache_bind (disk_sector_t sector);
+static void cache_put (struct page *slot);
+static void cache_flush (int64_t expire);
+static void cache_transfer (struct page **run, size_t cnt, bool write);
 
-/* The initializer of file vm */
+/* Sets up the cache slots.  Must be called before the first
+ * inode is touched, that is, early in filesys_init().  The worker
+ * threads come later, from pagecache_init(): the cache works
+ * without them, only synchronously. */
+void
+page_cache_init (void) {
+	uint8_t *kva = palloc_get_multiple (PAL_ASSERT | PAL_ZERO,
+			PAGE_CACHE_PAGES);
+
+	lock_init (&cache_lock);
+	cond_init (&slot_unpinned);
+	hash_init (&cache_map, slot_hash, slot_less, NULL);
+	lock_init (&readahead_lock);
+	cond_init (&readahead_cond);
+	for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
+		struct page *slot = calloc (1, sizeof *slot);
+		if (slot == NULL)
+			PANIC ("page cache init failed");
+		page_cache_initializer (slot, VM_PAGE_CACHE,
+				kva + i * DISK_SECTOR_SIZE);
+		slots[i] = slot;
+	}
+}
+
+/* Starts the write-behind and read-ahead threads.  Called from
+ * vm_init(); the slots themselves are set up by page_cache_init(). */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	page_cache_readahead_workerd = thread_create ("readaheadd", PRI_DEFAULT,
+			page_cache_readaheadd, NULL);
+	if (page_cache_workerd == TID_ERROR
+			|| page_cache_readahead_workerd == TID_ERROR)
+		PANIC ("page cache worker creation failed");
 }
 
 /* Initialize the page cache */
@@ -26,25 +131,426 @@ bool
 page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
+	page->type = type;
 
+	struct page_cache *pc = &page->page_cache;
+	pc->sector = PAGE_CACHE_EMPTY;
+	pc->kva = kva;
+	pc->dirty = false;
+	pc->accessed = false;
+	pc->pin_cnt = 0;
+	pc->dirty_since = 0;
+	lock_init (&pc->lock);
+	return true;
 }
 
 /* Utilze the Swap in mechanism to implement readhead */
 static bool
 page_cache_readahead (struct page *page, void *kva) {
+	struct page_cache *pc = &page->page_cache;
+
+	disk_read (filesys_disk, pc->sector, kva);
+	pc->dirty = false;
+	return true;
 }
 
 /* Utilze the Swap out mechanism to implement writeback */
 static bool
 page_cache_writeback (struct page *page) {
+	struct page_cache *pc = &page->page_cache;
+
+	if (pc->dirty) {
+		disk_write (filesys_disk, pc->sector, pc->kva);
+		pc->dirty = false;
+		writeback_cnt++;
+	}
+	return true;
 }
 
 /* Destory the page_cache. */
 static void
 page_cache_destroy (struct page *page) {
+	page_cache_writeback (page);
+	page->page_cache.sector = PAGE_CACHE_EMPTY;
 }
 
 /* Worker thread for page cache */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_kworkerd (void *aux UNUSED) {
+	int64_t checkpoint = timer_ticks ();
+
+	for (;;) {
+		timer_sleep (PAGE_CACHE_FLUSH_INTERVAL);
+		if (timer_elapsed (checkpoint) >= FAT_CHECKPOINT_INTERVAL) {
+			cache_flush (INT64_MAX);
+			fat_flush ();
+			checkpoint = timer_ticks ();
+		} else
+			cache_flush (timer_ticks () - PAGE_CACHE_DIRTY_EXPIRE);
+	}
+}
+
+/* Worker thread that brings queued sectors into the cache.  Runs
+ * of adjacent sectors queued back to back are read with one disk
+ * command. */
+static void
+page_cache_readaheadd (void *aux UNUSED) {
+	for (;;) {
+		disk_sector_t first;
+		struct page *run[PAGE_CACHE_RUN];
+		size_t cnt = 0;
+
+		lock_acquire (&readahead_lock);
+		while (readahead_cnt == 0)
+			cond_wait (&readahead_cond, &readahead_lock);
+		first = readahead_queue[readahead_head];
+		do {
+			readahead_head = (readahead_head + 1) % READAHEAD_QUEUE_SIZE;
+			readahead_cnt--;
+			cnt++;
+		} while (cnt < PAGE_CACHE_RUN && readahead_cnt > 0
+				&& readahead_queue[readahead_head] == first + cnt);
+		lock_release (&readahead_lock);
+
+		/* Bind a slot to each sector not cached yet.  The slots stay
+		 * locked until they are filled. */
+		for (size_t i = 0; i < cnt; i++) {
+			struct hash_elem *e;
+			struct page key;
+
+			lock_acquire (&cache_lock);
+			key.page_cache.sector = first + i;
+			do {
+				e = hash_find (&cache_map, &key.spt_elem);
+				if (e != NULL) {
+					lock_release (&cache_lock);
+					break;
+				}
+				run[i] = cache_bind (first + i);
+			} while (run[i] == NULL);
+			if (e != NULL)
+				run[i] = NULL;
+			else
+				readahead_load_cnt++;
+		}
+
+		/* Read the bound slots in one go. */
+		size_t n = 0;
+		for (size_t i = 0; i < cnt; i++)
+			if (run[i] != NULL)
+				run[n++] = run[i];
+		if (n > 0)
+			cache_transfer (run, n, false);
+	}
+}
+
+/* Asks the read-ahead worker to bring SECTOR into the cache, and
+ * returns without waiting for it. */
+void
+page_cache_readahead_async (disk_sector_t sector) {
+	lock_acquire (&readahead_lock);
+	if (readahead_cnt < READAHEAD_QUEUE_SIZE) {
+		size_t tail = (readahead_head + readahead_cnt) % READAHEAD_QUEUE_SIZE;
+		readahead_queue[tail] = sector;
+		readahead_cnt++;
+		cond_signal (&readahead_cond, &readahead_lock);
+	}
+	lock_release (&readahead_lock);
+}
+
+/* Reads SIZE bytes at SECTOR_OFS within SECTOR into BUFFER. */
+void
+page_cache_read (disk_sector_t sector, void *buffer, int sector_ofs,
+		int size) {
+	ASSERT (sector_ofs >= 0 && size >= 0);
+	ASSERT (sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	struct page *slot = cache_get (sector, true);
+	memcpy (buffer, (uint8_t *) slot->page_cache.kva + sector_ofs, size);
+	cache_put (slot);
+}
+
+/* Writes SIZE bytes from BUFFER at SECTOR_OFS within SECTOR.  The
+ * data reaches the disk when the slot is evicted or flushed. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, int sector_ofs,
+		int size) {
+	ASSERT (sector_ofs >= 0 && size >= 0);
+	ASSERT (sector_ofs + size <= DISK_SECTOR_SIZE);
+
+	/* A write that covers the whole sector need not read it first. */
+	bool whole = sector_ofs == 0 && size == DISK_SECTOR_SIZE;
+	struct page *slot = cache_get (sector, !whole);
+	struct page_cache *pc = &slot->page_cache;
+
+	memcpy ((uint8_t *) pc->kva + sector_ofs, buffer, size);
+	if (!pc->dirty) {
+		pc->dirty = true;
+		pc->dirty_since = timer_ticks ();
+	}
+	cache_put (slot);
+}
+
+/* Writes every dirty slot back to the disk. */
+void
+page_cache_flush (void) {
+	cache_flush (INT64_MAX);
+}
+
+/* Prints page cache statistics. */
+void
+page_cache_print_stats (void) {
+	printf ("Page cache: %lld hits, %lld misses, %lld read ahead, "
+			"%lld writebacks\n",
+			hit_cnt, miss_cnt, readahead_load_cnt, writeback_cnt);
+}
+
+/* Picks an unpinned slot to reuse, giving recently used slots a
+ * second chance and preferring clean slots over dirty ones.  If
+ * every slot is pinned, waits for one to be unpinned and returns
+ * NULL instead, since the caller's lookup may be stale by then.
+ * Must be called with CACHE_LOCK held. */
+static struct page *
+cache_victim (void) {
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+
+	/* The first two sweeps look for a clean slot, the next two
+	 * accept a dirty one. */
+	for (size_t i = 0; i < PAGE_CACHE_SIZE * 4; i++) {
+		struct page *slot = slots[clock_hand];
+		struct page_cache *pc = &slot->page_cache;
+		clock_hand = (clock_hand + 1) % PAGE_CACHE_SIZE;
+
+		if (pc->pin_cnt > 0)
+			continue;
+		if (pc->accessed)
+			pc->accessed = false;
+		else if (!pc->dirty || i >= PAGE_CACHE_SIZE * 2)
+			return slot;
+	}
+	cond_wait (&slot_unpinned, &cache_lock);
+	return NULL;
+}
+
+/* Returns the slot caching SECTOR, pinned and locked.  On a miss
+ * a slot is recycled and, if LOAD is true, filled from the disk;
+ * otherwise the caller must overwrite the whole sector. */
+static struct page *
+cache_get (disk_sector_t sector, bool load) {
+	struct page key;
+	struct hash_elem *e;
+	struct page *slot;
+
+	lock_acquire (&cache_lock);
+	key.page_cache.sector = sector;
+	do {
+		e = hash_find (&cache_map, &key.spt_elem);
+		if (e != NULL) {
+			slot = hash_entry (e, struct page, spt_elem);
+			slot->page_cache.pin_cnt++;
+			hit_cnt++;
+			lock_release (&cache_lock);
+
+			/* Waits for whoever is filling the slot. */
+			lock_acquire (&slot->page_cache.lock);
+			slot->page_cache.accessed = true;
+			return slot;
+		}
+		slot = cache_bind (sector);
+	} while (slot == NULL);
+
+	miss_cnt++;
+	if (load)
+		swap_in (slot, slot->page_cache.kva);
+	return slot;
+}
+
+/* Recycles a slot for SECTOR, which must not be cached yet, and
+ * returns it pinned and locked without reading the sector in.
+ * Must be called with CACHE_LOCK held, which it releases.  Returns
+ * NULL, with CACHE_LOCK still held, if the caller has to look
+ * SECTOR up again first. */
+static struct page *
+cache_bind (disk_sector_t sector) {
+	struct page *slot = cache_victim ();
+
+	if (slot == NULL)
+		return NULL;
+
+	/* An unpinned slot is unlocked, so this does not block. */
+	lock_acquire (&slot->page_cache.lock);
+	if (slot->page_cache.dirty) {
+		struct page key;
+
+		/* Write the old sector back without holding up every other
+		 * cache user.  The slot stays mapped to it meanwhile, so no
+		 * one reads the stale sector off the disk, and the pin keeps
+		 * it from being picked again. */
+		slot->page_cache.pin_cnt++;
+		lock_release (&cache_lock);
+		swap_out (slot);
+		lock_acquire (&cache_lock);
+
+		/* Give the slot up if someone wants the old sector after all,
+		 * or has bound SECTOR elsewhere. */
+		key.page_cache.sector = sector;
+		if (slot->page_cache.pin_cnt > 1
+				|| hash_find (&cache_map, &key.spt_elem) != NULL) {
+			lock_release (&slot->page_cache.lock);
+			if (--slot->page_cache.pin_cnt == 0)
+				cond_broadcast (&slot_unpinned, &cache_lock);
+			return NULL;
+		}
+		slot->page_cache.pin_cnt--;
+	}
+	if (slot->page_cache.sector != PAGE_CACHE_EMPTY)
+		hash_delete (&cache_map, &slot->spt_elem);
+	slot->page_cache.sector = sector;
+	slot->page_cache.pin_cnt++;
+	hash_insert (&cache_map, &slot->spt_elem);
+	lock_release (&cache_lock);
+
+	slot->page_cache.accessed = true;
+	return slot;
+}
+
+/* Unlocks and unpins SLOT. */
+static void
+cache_put (struct page *slot) {
+	lock_release (&slot->page_cache.lock);
+	lock_acquire (&cache_lock);
+	if (--slot->page_cache.pin_cnt == 0)
+		cond_broadcast (&slot_unpinned, &cache_lock);
+	lock_release (&cache_lock);
+}
+
+/* Writes back the slots that became dirty no later than EXPIRE,
+ * at most PAGE_CACHE_FLUSH_BATCH at a time.  Each batch is queued
+ * together, so the disk driver can order it and merge adjacent
+ * sectors into one command. */
+static void
+cache_flush (int64_t expire) {
+	size_t next = 0;
+
+	while (next < PAGE_CACHE_SIZE) {
+		struct page *dirty[PAGE_CACHE_FLUSH_BATCH];
+		size_t dirty_cnt = 0, write_cnt = 0;
+
+		/* Pin the next batch of candidates, sorted by sector. */
+		lock_acquire (&cache_lock);
+		for (; next < PAGE_CACHE_SIZE && dirty_cnt < PAGE_CACHE_FLUSH_BATCH;
+				next++) {
+			struct page *slot = slots[next];
+			struct page_cache *pc = &slot->page_cache;
+			size_t j;
+
+			if (!pc->dirty || pc->dirty_since > expire)
+				continue;
+			pc->pin_cnt++;
+			for (j = dirty_cnt++; j > 0
+					&& dirty[j - 1]->page_cache.sector > pc->sector; j--)
+				dirty[j] = dirty[j - 1];
+			dirty[j] = slot;
+		}
+		lock_release (&cache_lock);
+
+		for (size_t i = 0; i < dirty_cnt; i++) {
+			struct page *slot = dirty[i];
+
+			/* Someone else may have written it back meanwhile. */
+			lock_acquire (&slot->page_cache.lock);
+			if (!slot->page_cache.dirty)
+				cache_put (slot);
+			else
+				dirty[write_cnt++] = slot;
+		}
+		if (write_cnt > 0)
+			cache_transfer (dirty, write_cnt, true);
+	}
+}
+
+/* Writes back or reads in the CNT locked and pinned slots in
+ * RUN, according to WRITE, then unlocks and unpins them.  Each
+ * slot is its own disk request, all submitted at once, and the
+ * disk driver merges adjacent ones. */
+static void
+cache_transfer (struct page **run, size_t cnt, bool write) {
+	struct disk_request *reqs = malloc (cnt * sizeof *reqs);
+
+	if (reqs == NULL) {
+		/* One at a time, then. */
+		for (size_t i = 0; i < cnt; i++) {
+			if (write)
+				swap_out (run[i]);
+			else
+				swap_in (run[i], run[i]->page_cache.kva);
+			cache_put (run[i]);
+		}
+		return;
+	}
+
+	disk_plug (filesys_disk);
+	for (size_t i = 0; i < cnt; i++) {
+		struct page_cache *pc = &run[i]->page_cache;
+		disk_request_init (&reqs[i], filesys_disk, pc->sector, 1, pc->kva,
+				write);
+		disk_submit (&reqs[i]);
+	}
+	disk_unplug (filesys_disk);
+
+	for (size_t i = 0; i < cnt; i++) {
+		disk_wait (&reqs[i]);
+		run[i]->page_cache.dirty = false;
+		if (write)
+			writeback_cnt++;
+		cache_put (run[i]);
+	}
+	free (reqs);
+}
+
+static uint64_t
+slot_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *slot = hash_entry (e, struct page, spt_elem);
+	return hash_int (slot->page_cache.sector);
+}
+
+static bool
+slot_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	const struct page *slot_a = hash_entry (a, struct page, spt_elem);
+	const struct page *slot_b = hash_entry (b, struct page, spt_elem);
+	return slot_a->page_cache.sector < slot_b->page_cache.sector;
+}
+#else
+/* Without EFILESYS there is no page cache; accesses go straight to
+ * the disk. */
+bool
+page_cache_initializer (struct page *page UNUSED, enum vm_type type UNUSED,
+		void *kva UNUSED) {
+	return false;
+}
+
+void
+page_cache_read (disk_sector_t sector, void *buffer, int sector_ofs,
+		int size) {
+	uint8_t bounce[DISK_SECTOR_SIZE];
+
+	disk_read (filesys_disk, sector, bounce);
+	memcpy (buffer, bounce + sector_ofs, size);
+}
+
+void
+page_cache_write (disk_sector_t sector, const void *buffer, int sector_ofs,
+		int size) {
+	uint8_t bounce[DISK_SECTOR_SIZE];
+
+	if (sector_ofs > 0 || size < DISK_SECTOR_SIZE)
+		disk_read (filesys_disk, sector, bounce);
+	memcpy (bounce + sector_ofs, buffer, size);
+	disk_write (filesys_disk, sector, bounce);
+}
+
+void
+page_cache_readahead_async (disk_sector_t sector UNUSED) {
 }
+#endif
@@ -2,7 +2,11 @@
 #define DEVICES_DISK_H
 
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,6 +19,34 @@ typedef uint32_t disk_sector_t;
  * printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Use bus master DMA instead of PIO where possible? */
+extern bool disk_use_dma;
+
+/* Most sectors one request may cover. */
+#define DISK_REQUEST_MAX 256
+
+struct disk_request;
+
+/* Called by a channel's worker thread when request R completes.
+ * Must not wait for the disk. */
+typedef void disk_request_func (struct disk_request *r);
+
+/* An asynchronous transfer, queued with disk_submit(). */
+struct disk_request {
+	struct disk *disk;          /* Disk to transfer to or from. */
+	disk_sector_t sector;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+	bool write;                 /* Write BUFFER out, or read into it? */
+	disk_request_func *callback;    /* Completion callback, or NULL. */
+	void *aux;                  /* For CALLBACK's use. */
+
+	/* Owned by the driver. */
+	struct semaphore done;      /* Up'd on completion if no CALLBACK. */
+	int64_t deadline;           /* Tick by which it should be served. */
+	struct list_elem elem;      /* Channel queue element. */
+};
+
 void disk_init (void);
 void disk_print_stats (void);
 
@@ -22,6 +54,16 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multi (struct disk *, disk_sector_t, size_t cnt, void *);
+void disk_write_multi (struct disk *, disk_sector_t, size_t cnt,
+		const void *);
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+		size_t cnt, void *buffer, bool write);
+void disk_submit (struct disk_request *);
+void disk_wait (struct disk_request *);
+void disk_plug (struct disk *);
+void disk_unplug (struct disk *);
 
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -0,0 +1,22 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Sector recorded for a name known not to exist in its directory. */
+#define DCACHE_NEGATIVE ((disk_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sectorp);
+unsigned dcache_generation (disk_sector_t parent);
+void dcache_fill (disk_sector_t parent, const char *name,
+		disk_sector_t sector, unsigned gen);
+void dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+void dcache_invalidate (disk_sector_t parent, const char *name);
+void dcache_purge_dir (disk_sector_t parent);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
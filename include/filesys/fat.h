@@ -32,11 +32,17 @@ void fat_init (void);
 void fat_open (void);
 void fat_close (void);
 void fat_create (void);
+void fat_flush (void);
 void fat_close (void);
 
 cluster_t fat_create_chain (
     cluster_t clst /* Cluster # to stretch, 0: Create a new chain */
 );
+cluster_t fat_extend_chain (
+    cluster_t tail,        /* Last cluster of the chain, 0: new chain */
+    size_t cnt,            /* Number of clusters to add */
+    cluster_t *clusters    /* If not null, receives the new clusters */
+);
 void fat_remove_chain (
     cluster_t clst, /* Cluster # to be removed */
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
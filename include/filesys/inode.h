@@ -2,6 +2,8 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "filesys/off_t.h"
 #include "devices/disk.h"
 
@@ -16,12 +18,17 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+void inode_readahead (struct inode *, off_t offset, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+uint32_t inode_get_dir_buckets (const struct inode *);
+void inode_set_dir_buckets (struct inode *, uint32_t bucket_cnt);
 bool inode_is_dir(const struct inode *inode);
 void inode_tag_dir(struct inode *inode);
 bool inode_is_removed(const struct inode *inode);
 void inode_tag_sym_link(struct inode *target_inode);
 bool inode_is_symlink(const struct inode *inode);
+size_t inode_open_count (void);
+void inode_print_stats (void);
 #endif /* filesys/inode.h */
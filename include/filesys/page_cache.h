@@ -1,12 +1,36 @@
 #ifndef FILESYS_PAGE_CACHE_H
 #define FILESYS_PAGE_CACHE_H
-#include "vm/vm.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/disk.h"
+#include "threads/synch.h"
 
 struct page;
 enum vm_type;
 
-struct page_cache {};
+/* One slot of the buffer cache.  Each slot caches a single disk
+ * sector of the file system disk. */
+struct page_cache {
+	disk_sector_t sector;       /* Cached sector, or PAGE_CACHE_EMPTY. */
+	void *kva;                  /* Slot contents, DISK_SECTOR_SIZE bytes. */
+	bool dirty;                 /* Newer than the copy on disk? */
+	bool accessed;              /* Used since the clock hand passed? */
+	int pin_cnt;                /* Number of users; pinned slots stay. */
+	int64_t dirty_since;        /* Tick of the oldest unflushed write. */
+	struct lock lock;           /* Held while copying in or out. */
+};
+
+/* Sector number of a slot that caches nothing. */
+#define PAGE_CACHE_EMPTY ((disk_sector_t) -1)
 
 void page_cache_init (void);
+void pagecache_init (void);
 bool page_cache_initializer (struct page *page, enum vm_type type, void *kva);
+
+void page_cache_read (disk_sector_t, void *buffer, int sector_ofs, int size);
+void page_cache_write (disk_sector_t, const void *buffer, int sector_ofs,
+		int size);
+void page_cache_readahead_async (disk_sector_t);
+void page_cache_flush (void);
+void page_cache_print_stats (void);
 #endif
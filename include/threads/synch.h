@@ -45,6 +45,22 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock {
+	struct lock lock;           /* Protects the fields below. */
+	struct condition readers_ok; /* Signaled when readers may enter. */
+	struct condition writers_ok; /* Signaled when a writer may enter. */
+	int reader_cnt;             /* Number of readers holding it. */
+	int waiting_writer_cnt;     /* Number of writers waiting. */
+	struct thread *writer;      /* Writer holding it, if any. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
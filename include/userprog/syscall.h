@@ -3,6 +3,4 @@
 
 void syscall_init (void);
 
-struct lock file_rw_lock;
-
 #endif /* userprog/syscall.h */
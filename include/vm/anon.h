@@ -4,11 +4,18 @@
 struct page;
 enum vm_type;
 
+/* Most pages anon_swap_in_cluster() takes at once. */
+#define ANON_CLUSTER_MAX 8
+
 struct anon_page {
     size_t swap_idx;
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_swap_share (struct page *page, size_t slot);
+bool anon_swap_in_cluster (struct page **pages, size_t cnt);
+void anon_swap_plug (void);
+void anon_swap_unplug (void);
 
 #endif
@@ -20,6 +20,9 @@ struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	off_t ra_next;              /* Offset just past the last read. */
+	int ra_seq_cnt;             /* Number of back-to-back sequential reads. */
+	off_t ra_end;               /* Read-ahead has been issued up to here. */
 };
 
 // user addition for lazy loading
@@ -35,6 +38,7 @@ struct Inform_mmap_file {
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+bool file_backed_writeback (struct page *page);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
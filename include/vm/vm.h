@@ -54,9 +54,8 @@ struct page {
 	struct thread *t; 
 	bool writable;
 	enum vm_type type;
-	struct list shared_pages;
-	struct list_elem pages_elem;
-	bool is_needed_to_cow;
+	struct list_elem pages_elem;   /* Element in frame's PAGES. */
+	bool is_needed_to_cow;         /* Mapped read-only to share its frame? */
 	// bool dirty_bit;
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -71,12 +70,30 @@ struct page {
 };
 
 /* The representation of "frame" */
+/* The descriptor of a page of the user pool.  There is one for
+ * every page, so it is never freed. */
 struct frame {
 	void *kva;
-	struct page *page;
-	struct list_elem ft_elem;
+	struct page *page;     /* Page whose operations swap the frame. */
+	struct list pages;     /* Pages mapping the frame, PAGE included. */
+	struct list_elem ft_elem;  /* In frame table or free list. */
+	bool busy;             /* Held exclusively: being swapped
+	                          out, cleaned, or pinned. */
+
+	/* Program text the frame holds, shared by every process. */
+	struct inode *text_inode;  /* Executable, or NULL if not text. */
+	off_t text_ofs;            /* Offset of the page in it. */
+	off_t text_bytes;          /* Bytes read, the rest is zeroes. */
+	struct hash_elem text_elem;
 };
 
+/* Page replacement policies, chosen with -vm-evict=. */
+enum vm_evict_policy {
+	VM_EVICT_CLOCK,        /* Second chance, by PTE accessed bits. */
+	VM_EVICT_FIFO,         /* Oldest loaded page first. */
+};
+extern enum vm_evict_policy vm_evict_policy;
+
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
  * Put the table of "method" into the struct's member, and
@@ -113,6 +130,9 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
+void vm_print_stats (void);
+bool vm_frame_test_dirty (struct frame *frame, bool clear);
+bool vm_writeback_page (struct page *page);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -266,6 +266,31 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none.  Skips a whole
+   element at a time. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value) {
+	size_t idx = elem_idx (start);
+	size_t elems = elem_cnt (b->bit_cnt);
+	elem_type flip = value ? 0 : (elem_type) -1;
+
+	if (start >= b->bit_cnt)
+		return b->bit_cnt;
+
+	/* Ignore the bits below START in the first element. */
+	elem_type word = (b->bits[idx] ^ flip)
+		& ((elem_type) -1 << (start % ELEM_BITS));
+	while (word == 0) {
+		if (++idx >= elems)
+			return b->bit_cnt;
+		word = b->bits[idx] ^ flip;
+	}
+
+	size_t bit = idx * ELEM_BITS + __builtin_ctzl (word);
+	return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -275,12 +300,21 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-				if (!bitmap_contains (b, i, cnt, !value))
-					return i;
+		size_t i = start;
+		while (i <= last) {
+			/* Jump to the next candidate, then to the end of its run. */
+			i = next_bit (b, i, value);
+			if (i > last)
+				break;
+			size_t end = next_bit (b, i, !value);
+			if (end - i >= cnt)
+				return i;
+			i = end;
+		}
 	}
 
 	return BITMAP_ERROR;
@@ -0,0 +1,44 @@
+/* Writes a file and reads it back twice, checking that the
+   second read is served from the buffer cache without reading
+   the disk. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#define TEST_SIZE 4096
+
+static const char file_name[] = "data";
+static char buf[TEST_SIZE];
+static char buf2[TEST_SIZE];
+
+void
+test_main (void) {
+  int fd;
+  long long read_cnt;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+
+  seek (fd, 0);
+  CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2,
+         "read \"%s\"", file_name);
+  if (memcmp (buf, buf2, sizeof buf))
+    fail ("file content mismatch");
+
+  read_cnt = get_fs_disk_read_cnt ();
+  memset (buf2, 0, sizeof buf2);
+  seek (fd, 0);
+  CHECK (read (fd, buf2, sizeof buf2) == sizeof buf2,
+         "read \"%s\" again", file_name);
+  if (memcmp (buf, buf2, sizeof buf))
+    fail ("file content mismatch");
+  CHECK (get_fs_disk_read_cnt () == read_cnt, "check read_cnt");
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,49 @@
+/* Child process for syn-over.
+   Reads the file our parent process keeps overwriting, a sector
+   at a time, and checks that each sector is whole: all zeros, as
+   created, or all one byte, as one write left it, never a mix of
+   two writes.  Overwrites must not change the file's length. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-over.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-over";
+
+static char buf[SECTOR_SIZE];
+
+#define PASS_CNT 50
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx, pass;
+  int fd;
+  size_t ofs, i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (pass = 0; pass < PASS_CNT; pass++)
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += SECTOR_SIZE)
+        {
+          CHECK (read (fd, buf, SECTOR_SIZE) == SECTOR_SIZE,
+                 "read %d bytes at offset %zu in \"%s\"",
+                 SECTOR_SIZE, ofs, file_name);
+          for (i = 1; i < SECTOR_SIZE; i++)
+            if (buf[i] != buf[0])
+              fail ("sector at offset %zu in \"%s\" mixes bytes "
+                    "0x%02hhx and 0x%02hhx", ofs, file_name, buf[0], buf[i]);
+        }
+      CHECK (filesize (fd) == FILE_SIZE, "size of \"%s\"", file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
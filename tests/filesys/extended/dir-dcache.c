@@ -0,0 +1,47 @@
+/* Checks that name lookups never return a stale answer once the
+   name changes: a file looked up, then removed and created again,
+   opens as the new file; a name that was not found is found once
+   it is created; and a directory removed and made again does not
+   inherit the names of the old one.  (Pintos has no rename, so
+   remove and create are the only ways a name changes.) */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Opens NAME, which must exist and be SIZE bytes long, and closes
+   it again. */
+static void
+check_size (const char *name, int size)
+{
+  int fd;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  CHECK (filesize (fd) == size, "\"%s\" is %d bytes long", name, size);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  CHECK (mkdir ("/a"), "mkdir \"/a\"");
+  CHECK (create ("/a/f", 0), "create \"/a/f\"");
+  check_size ("/a/f", 0);
+  CHECK (open ("/a/g") == -1, "open \"/a/g\" (must fail)");
+
+  CHECK (create ("/a/g", 0), "create \"/a/g\"");
+  check_size ("/a/g", 0);
+
+  CHECK (remove ("/a/f"), "remove \"/a/f\"");
+  CHECK (open ("/a/f") == -1, "open \"/a/f\" (must fail)");
+  CHECK (create ("/a/f", 512), "create \"/a/f\"");
+  check_size ("/a/f", 512);
+
+  CHECK (remove ("/a/f"), "remove \"/a/f\"");
+  CHECK (remove ("/a/g"), "remove \"/a/g\"");
+  CHECK (remove ("/a"), "remove \"/a\"");
+  CHECK (open ("/a/g") == -1, "open \"/a/g\" (must fail)");
+  CHECK (mkdir ("/a"), "mkdir \"/a\"");
+  CHECK (open ("/a/f") == -1, "open \"/a/f\" (must fail)");
+  CHECK (open ("/a/g") == -1, "open \"/a/g\" (must fail)");
+}
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-dcache) begin
+(dir-dcache) mkdir "/a"
+(dir-dcache) create "/a/f"
+(dir-dcache) open "/a/f"
+(dir-dcache) "/a/f" is 0 bytes long
+(dir-dcache) open "/a/g" (must fail)
+(dir-dcache) create "/a/g"
+(dir-dcache) open "/a/g"
+(dir-dcache) "/a/g" is 0 bytes long
+(dir-dcache) remove "/a/f"
+(dir-dcache) open "/a/f" (must fail)
+(dir-dcache) create "/a/f"
+(dir-dcache) open "/a/f"
+(dir-dcache) "/a/f" is 512 bytes long
+(dir-dcache) remove "/a/f"
+(dir-dcache) remove "/a/g"
+(dir-dcache) remove "/a"
+(dir-dcache) open "/a/g" (must fail)
+(dir-dcache) mkdir "/a"
+(dir-dcache) open "/a/f" (must fail)
+(dir-dcache) open "/a/g" (must fail)
+(dir-dcache) end
+EOF
+pass;
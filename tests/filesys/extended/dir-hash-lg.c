@@ -0,0 +1,88 @@
+/* Creates more files in a directory than its primary hash
+   buckets hold, so that the directory, which starts out flat, is
+   rehashed and some of them go to overflow buckets,
+   then checks that each can be opened by name and that readdir()
+   returns each exactly once, before and after every other file
+   is removed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* More than the 8 primary buckets of 25 entries each can hold. */
+#define FILE_CNT 240
+
+static bool seen[FILE_CNT];
+
+/* Reads directory "/x" and checks that it holds exactly the files
+   whose numbers are multiples of STEP. */
+static void
+check_readdir (int step)
+{
+  char name[READDIR_MAX_LEN + 1];
+  int fd, cnt = 0;
+
+  CHECK ((fd = open ("/x")) > 1, "open \"/x\"");
+  memset (seen, 0, sizeof seen);
+  while (readdir (fd, name))
+    {
+      int i;
+
+      if (memcmp (name, "file", 4) != 0)
+        fail ("readdir returned unexpected \"%s\"", name);
+      i = atoi (name + 4);
+      if (i < 0 || i >= FILE_CNT || i % step != 0)
+        fail ("readdir returned unexpected \"%s\"", name);
+      if (seen[i])
+        fail ("readdir returned \"%s\" twice", name);
+      seen[i] = true;
+      cnt++;
+    }
+  if (cnt != (FILE_CNT + step - 1) / step)
+    fail ("readdir returned %d files", cnt);
+  msg ("readdir \"/x\"");
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  char file_name[32];
+  int i;
+
+  CHECK (mkdir ("/x"), "mkdir \"/x\"");
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (file_name, sizeof file_name, "/x/file%d", i);
+      if (!create (file_name, 0))
+        fail ("create \"%s\"", file_name);
+    }
+  msg ("create %d files in \"/x\"", FILE_CNT);
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      int fd;
+
+      snprintf (file_name, sizeof file_name, "/x/file%d", i);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\"", file_name);
+      close (fd);
+    }
+  msg ("open each file by name");
+
+  check_readdir (1);
+
+  for (i = 1; i < FILE_CNT; i += 2)
+    {
+      snprintf (file_name, sizeof file_name, "/x/file%d", i);
+      if (!remove (file_name))
+        fail ("remove \"%s\"", file_name);
+    }
+  msg ("remove every other file");
+
+  check_readdir (2);
+}
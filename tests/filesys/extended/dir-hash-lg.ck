@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-hash-lg) begin
+(dir-hash-lg) mkdir "/x"
+(dir-hash-lg) create 240 files in "/x"
+(dir-hash-lg) open each file by name
+(dir-hash-lg) open "/x"
+(dir-hash-lg) readdir "/x"
+(dir-hash-lg) remove every other file
+(dir-hash-lg) open "/x"
+(dir-hash-lg) readdir "/x"
+(dir-hash-lg) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"child-syn-over" => "tests/filesys/extended/child-syn-over",
+		"overfile" => ["t" x (8 * 512)]});
+pass;
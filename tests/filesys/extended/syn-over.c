@@ -0,0 +1,41 @@
+/* Overwrites a file sector by sector, over and over, while
+   subprocesses read it, so that readers and an in-place writer
+   hold the file at the same time.  Each round fills the whole
+   file with one byte. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-over.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[SECTOR_SIZE];
+
+#define CHILD_CNT 4
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int fd, round;
+  size_t ofs;
+
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  exec_children ("child-syn-over", children, CHILD_CNT);
+
+  quiet = true;
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      memset (buf, 'a' + round, sizeof buf);
+      seek (fd, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += SECTOR_SIZE)
+        CHECK (write (fd, buf, SECTOR_SIZE) == SECTOR_SIZE,
+               "write %d bytes at offset %zu in \"%s\"",
+               SECTOR_SIZE, ofs, file_name);
+    }
+  quiet = false;
+
+  wait_children (children, CHILD_CNT);
+}
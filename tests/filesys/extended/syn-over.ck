@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-over) begin
+(syn-over) create "overfile"
+(syn-over) open "overfile"
+(syn-over) exec child 1 of 4: "child-syn-over 0"
+(syn-over) exec child 2 of 4: "child-syn-over 1"
+(syn-over) exec child 3 of 4: "child-syn-over 2"
+(syn-over) exec child 4 of 4: "child-syn-over 3"
+(syn-over) wait for child 1 of 4 returned 0 (expected 0)
+(syn-over) wait for child 2 of 4 returned 1 (expected 1)
+(syn-over) wait for child 3 of 4 returned 2 (expected 2)
+(syn-over) wait for child 4 of 4 returned 3 (expected 3)
+(syn-over) end
+EOF
+pass;
@@ -0,0 +1,10 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_OVER_H
+#define TESTS_FILESYS_EXTENDED_SYN_OVER_H
+
+#define SECTOR_SIZE 512
+#define SECTOR_CNT 8
+#define FILE_SIZE (SECTOR_SIZE * SECTOR_CNT)
+#define ROUND_CNT 20
+static const char file_name[] = "overfile";
+
+#endif /* tests/filesys/extended/syn-over.h */
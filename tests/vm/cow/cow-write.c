@@ -0,0 +1,51 @@
+/* Checks that after fork, writes on either side of a page shared
+ * copy-on-write stay on that side. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_SIZE (4 * PAGE_SIZE)
+
+static char buf[CHUNK_SIZE];
+
+/* Returns true if every byte of BUF is C. */
+static bool
+filled_with (char c)
+{
+	size_t i;
+
+	for (i = 0 ; i < CHUNK_SIZE ; i++)
+		if (buf[i] != c)
+			return false;
+	return true;
+}
+
+void
+test_main (void)
+{
+	pid_t child;
+
+	memset (buf, 'A', CHUNK_SIZE);
+	msg ("write before fork");
+
+	child = fork ("child");
+	if (child == 0) {
+		/* Whether or not the parent has written yet, the child sees
+		 * the data as it was at fork. */
+		if (!filled_with ('A'))
+			exit (1);
+		memset (buf, 'C', CHUNK_SIZE);
+		if (!filled_with ('C'))
+			exit (2);
+		exit (0x42);
+	}
+
+	memset (buf, 'P', CHUNK_SIZE);
+	CHECK (wait (child) == 0x42, "child sees only its own writes");
+	CHECK (filled_with ('P'), "parent sees only its own writes");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-write) begin
+(cow-write) write before fork
+(cow-write) child sees only its own writes
+(cow-write) parent sees only its own writes
+(cow-write) end
+EOF
+pass;
@@ -0,0 +1,65 @@
+/* Forks a process with a large untouched BSS and a large untouched
+ * file mapping, and checks that the fork allocates no frame for
+ * either: every page is still unmapped in the child, and again in
+ * the parent after the child has touched some of them.  The pages
+ * the child touches must still read right. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BSS_PAGE_COUNT 512
+#define MAP_PAGE_COUNT 256
+
+static char bss[BSS_PAGE_COUNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char *map = (char *) 0x10000000;
+
+/* Checks that no page of the BSS chunk or the mapping has a
+ * frame. */
+static void
+check_unmapped (const char *who)
+{
+	size_t i;
+
+	for (i = 0 ; i < BSS_PAGE_COUNT ; i++)
+		if (get_phys_addr (&bss[i * PAGE_SIZE]) != 0)
+			fail ("%s: BSS page %zu has a frame", who, i);
+	for (i = 0 ; i < MAP_PAGE_COUNT ; i++)
+		if (get_phys_addr (&map[i * PAGE_SIZE]) != 0)
+			fail ("%s: mapped page %zu has a frame", who, i);
+	msg ("%s: no page has a frame", who);
+}
+
+void
+test_main (void)
+{
+	char expected[PAGE_SIZE];
+	int handle;
+	pid_t child;
+	size_t i;
+
+	CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+	CHECK (mmap (map, MAP_PAGE_COUNT * PAGE_SIZE, 0, handle, 0) != MAP_FAILED,
+			"mmap \"large.txt\"");
+	check_unmapped ("parent");
+
+	child = fork ("child");
+	if (child == 0) {
+		check_unmapped ("child");
+
+		for (i = 0 ; i < BSS_PAGE_COUNT ; i += 64)
+			if (bss[i * PAGE_SIZE] != 0)
+				fail ("BSS page %zu is not zeroed", i);
+		seek (handle, 0);
+		CHECK (read (handle, expected, PAGE_SIZE) == PAGE_SIZE,
+				"read \"large.txt\"");
+		CHECK (!memcmp (map, expected, PAGE_SIZE),
+				"child: mapped page 0 holds the file");
+		exit (0);
+	}
+	CHECK (wait (child) == 0, "wait for child");
+	check_unmapped ("parent");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-lazy) begin
+(fork-lazy) open "large.txt"
+(fork-lazy) mmap "large.txt"
+(fork-lazy) parent: no page has a frame
+(fork-lazy) child: no page has a frame
+(fork-lazy) read "large.txt"
+(fork-lazy) child: mapped page 0 holds the file
+(fork-lazy) wait for child
+(fork-lazy) parent: no page has a frame
+(fork-lazy) end
+EOF
+pass;
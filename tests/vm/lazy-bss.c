@@ -0,0 +1,57 @@
+/* Checks that reading untouched BSS maps every page to one shared
+ * zero page, and that a write then gives the page a private
+ * frame of its own, leaving the others zero. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_PAGE_COUNT 4
+#define CHUNK_SIZE (CHUNK_PAGE_COUNT * PAGE_SIZE)
+
+static char bss[CHUNK_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+	size_t i, j;
+	void *pa, *zero_pa;
+
+	msg ("read pages");
+	for (i = 0 ; i < CHUNK_PAGE_COUNT ; i++)
+		for (j = 0 ; j < PAGE_SIZE ; j++)
+			if (bss[i*PAGE_SIZE + j] != 0)
+				fail ("page %zu is not zeroed", i);
+
+	zero_pa = get_phys_addr(&bss[0]);
+	CHECK (zero_pa != 0, "check if page is mapped");
+	for (i = 1 ; i < CHUNK_PAGE_COUNT ; i++) {
+		pa = get_phys_addr(&bss[i*PAGE_SIZE]);
+		if (pa != zero_pa)
+			fail ("page %zu is not the shared zero page", i);
+	}
+	msg ("check if pages share one frame");
+
+	msg ("write page [1]");
+	memset (&bss[PAGE_SIZE], 'x', PAGE_SIZE);
+	pa = get_phys_addr(&bss[PAGE_SIZE]);
+	CHECK (pa != 0 && pa != zero_pa, "check if page has a frame of its own");
+	for (j = 0 ; j < PAGE_SIZE ; j++)
+		if (bss[PAGE_SIZE + j] != 'x')
+			fail ("page 1 lost the write");
+	msg ("check memory content");
+
+	for (i = 0 ; i < CHUNK_PAGE_COUNT ; i++) {
+		if (i == 1)
+			continue;
+		for (j = 0 ; j < PAGE_SIZE ; j++)
+			if (bss[i*PAGE_SIZE + j] != 0)
+				fail ("page %zu is not zeroed", i);
+		CHECK (get_phys_addr(&bss[i*PAGE_SIZE]) == zero_pa,
+				"check if page [%zu] is still the zero page", i);
+	}
+}
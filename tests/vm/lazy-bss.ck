@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lazy-bss) begin
+(lazy-bss) read pages
+(lazy-bss) check if page is mapped
+(lazy-bss) check if pages share one frame
+(lazy-bss) write page [1]
+(lazy-bss) check if page has a frame of its own
+(lazy-bss) check memory content
+(lazy-bss) check if page [0] is still the zero page
+(lazy-bss) check if page [2] is still the zero page
+(lazy-bss) check if page [3] is still the zero page
+(lazy-bss) end
+EOF
+pass;
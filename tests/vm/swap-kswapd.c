@@ -0,0 +1,58 @@
+/* Runs several processes that each fill and check more memory than
+ * a third of the machine has, at the same time, so that frames are
+ * evicted concurrently, both by the faulting processes and by the
+ * background reclaimer.  For this test, Pintos memory size is
+ * 10MB.  The check script compares the two eviction counts. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define CHUNK_SIZE (6 * ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+#define CHILD_CNT 3
+
+static char big_chunks[CHUNK_SIZE];
+
+/* Byte that page I of child ID holds. */
+static char
+page_byte (int id, size_t i)
+{
+  return (char) (id * 31 + i);
+}
+
+/* Fills every page of BIG_CHUNKS, reads them all back, and exits
+   with status ID, or fails. */
+static void
+child (int id)
+{
+  size_t i, j;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    memset (big_chunks + i * PAGE_SIZE, page_byte (id, i), PAGE_SIZE);
+  for (i = 0; i < PAGE_COUNT; i++)
+    for (j = 0; j < PAGE_SIZE; j++)
+      if (big_chunks[i * PAGE_SIZE + j] != page_byte (id, i))
+        fail ("child %d: data is inconsistent in page %zu", id, i);
+  exit (id);
+}
+
+void
+test_main (void)
+{
+  pid_t pids[CHILD_CNT];
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pids[i] = fork ("child");
+      if (pids[i] == 0)
+        child (i);
+      CHECK (pids[i] > 0, "fork child %d", i);
+    }
+  for (i = 0; i < CHILD_CNT; i++)
+    CHECK (wait (pids[i]) == i, "wait for child %d", i);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-kswapd) begin
+(swap-kswapd) fork child 0
+(swap-kswapd) fork child 1
+(swap-kswapd) fork child 2
+(swap-kswapd) wait for child 0
+(swap-kswapd) wait for child 1
+(swap-kswapd) wait for child 2
+(swap-kswapd) end
+EOF
+
+# Memory ran out, and kswapd, not only the faulting processes,
+# evicted frames to refill the free pool.
+our ($test);
+my ($stats) = grep (/^VM: \d+ page faults/, read_text_file ("$test.output"));
+fail "no VM statistics in the output\n" if !defined $stats;
+my ($evicted, $direct) = $stats =~ /(\d+) evictions \((\d+) direct\)/;
+fail "no frame was evicted\n" if !$evicted;
+fail "every eviction was direct, none by kswapd\n" if $direct >= $evicted;
+pass;
@@ -0,0 +1,57 @@
+/* Checks that anonymous pages come back intact from swap, both
+ * those that compress well, which the compressed tier keeps in
+ * memory, and those that do not, which go to the swap disk.
+ * For this test, Pintos memory size is 10MB.  Even pages are
+ * filled with one byte, odd pages with an RC4 keystream. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define ONE_MB (1 << 20) // 1MB
+#define CHUNK_SIZE (20*ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char big_chunks[CHUNK_SIZE];
+static char expected[PAGE_SIZE];
+
+/* Fills EXPECTED with what page I should hold. */
+static void
+make_page (size_t i)
+{
+	struct arc4 arc4;
+
+	if (i % 2 == 0) {
+		memset (expected, (char) i, PAGE_SIZE);
+		return;
+	}
+	memset (expected, 0, PAGE_SIZE);
+	arc4_init (&arc4, &i, sizeof i);
+	arc4_crypt (&arc4, expected, PAGE_SIZE);
+}
+
+void
+test_main (void) 
+{
+	size_t i;
+
+	for (i = 0 ; i < PAGE_COUNT ; i++) {
+		if (!(i % 512))
+			msg ("write page %zu", i);
+		make_page (i);
+		memcpy (big_chunks + i * PAGE_SIZE, expected, PAGE_SIZE);
+	}
+
+	for (i = 0 ; i < PAGE_COUNT ; i++) {
+		make_page (i);
+		if (memcmp (big_chunks + i * PAGE_SIZE, expected, PAGE_SIZE))
+			fail ("data is inconsistent in page %zu", i);
+		if (!(i % 512))
+			msg ("check consistency in page %zu", i);
+	}
+}
@@ -0,0 +1,38 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-zswap) begin
+(swap-zswap) write page 0
+(swap-zswap) write page 512
+(swap-zswap) write page 1024
+(swap-zswap) write page 1536
+(swap-zswap) write page 2048
+(swap-zswap) write page 2560
+(swap-zswap) write page 3072
+(swap-zswap) write page 3584
+(swap-zswap) write page 4096
+(swap-zswap) write page 4608
+(swap-zswap) check consistency in page 0
+(swap-zswap) check consistency in page 512
+(swap-zswap) check consistency in page 1024
+(swap-zswap) check consistency in page 1536
+(swap-zswap) check consistency in page 2048
+(swap-zswap) check consistency in page 2560
+(swap-zswap) check consistency in page 3072
+(swap-zswap) check consistency in page 3584
+(swap-zswap) check consistency in page 4096
+(swap-zswap) check consistency in page 4608
+(swap-zswap) end
+EOF
+
+# Some pages must have made the round trip through the compressed
+# tier rather than the swap disk.
+our ($test);
+my ($stats) = grep (/^zswap: /, read_text_file ("$test.output"));
+fail "no zswap statistics in the output\n" if !defined $stats;
+my ($stored, $loaded) = $stats =~ /^zswap: (\d+) pages stored, (\d+) loaded/;
+fail "no page was kept compressed in memory\n" if !$stored;
+fail "no page was read back from the compressed tier\n" if !$loaded;
+pass;
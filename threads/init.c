@@ -36,7 +36,12 @@
 #ifdef FILESYS
 #include "devices/disk.h"
 #include "filesys/filesys.h"
+#include "filesys/dcache.h"
 #include "filesys/fsutil.h"
+#include "filesys/inode.h"
+#endif
+#ifdef EFILESYS
+#include "filesys/page_cache.h"
 #endif
 
 /* Page-map-level-4 with kernel mappings only. */
@@ -216,6 +221,8 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-dma"))
+			disk_use_dma = true;
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
@@ -226,6 +233,16 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-vm-evict")) {
+			if (value != NULL && !strcmp (value, "fifo"))
+				vm_evict_policy = VM_EVICT_FIFO;
+			else if (value != NULL && !strcmp (value, "clock"))
+				vm_evict_policy = VM_EVICT_CLOCK;
+			else
+				PANIC ("unknown eviction policy `%s'", value);
+		}
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -323,10 +340,14 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+			"  -dma               Use bus master DMA for disk transfers.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -vm-evict=POLICY   Evict pages by POLICY, clock or fifo.\n"
 #endif
 			);
 	power_off ();
@@ -355,10 +376,18 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	inode_print_stats ();
+	dcache_print_stats ();
+#endif
+#ifdef EFILESYS
+	page_cache_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
 }
@@ -348,6 +348,20 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	*bm_base += bm_pages;
 }
 
+/* Returns the number of pages in the user pool, usable or not. */
+size_t
+palloc_user_page_cnt (void) {
+	return bitmap_size (user_pool.used_map);
+}
+
+/* Returns the number of PAGE, a page of the user pool, counting
+   from the start of the pool. */
+size_t
+palloc_user_page_no (const void *page) {
+	ASSERT (page_from_pool (&user_pool, (void *) page));
+	return pg_no (page) - pg_no (user_pool.base);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
@@ -422,3 +422,79 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	while (!list_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes readers-writer lock RWLOCK.  Any number of readers
+   may hold it at once, or a single writer.  A waiting writer
+   keeps new readers out, so that a stream of readers cannot
+   starve it. */
+void
+rwlock_init (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	lock_init (&rwlock->lock);
+	cond_init (&rwlock->readers_ok);
+	cond_init (&rwlock->writers_ok);
+	rwlock->reader_cnt = 0;
+	rwlock->waiting_writer_cnt = 0;
+	rwlock->writer = NULL;
+}
+
+/* Acquires RWLOCK for reading, sleeping until no writer holds or
+   waits for it. */
+void
+rwlock_acquire_read (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rwlock->writer != thread_current ());
+
+	lock_acquire (&rwlock->lock);
+	while (rwlock->writer != NULL || rwlock->waiting_writer_cnt > 0)
+		cond_wait (&rwlock->readers_ok, &rwlock->lock);
+	rwlock->reader_cnt++;
+	lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	lock_acquire (&rwlock->lock);
+	ASSERT (rwlock->reader_cnt > 0);
+	if (--rwlock->reader_cnt == 0)
+		cond_signal (&rwlock->writers_ok, &rwlock->lock);
+	lock_release (&rwlock->lock);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no one else holds
+   it. */
+void
+rwlock_acquire_write (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rwlock->writer != thread_current ());
+
+	lock_acquire (&rwlock->lock);
+	rwlock->waiting_writer_cnt++;
+	while (rwlock->writer != NULL || rwlock->reader_cnt > 0)
+		cond_wait (&rwlock->writers_ok, &rwlock->lock);
+	rwlock->waiting_writer_cnt--;
+	rwlock->writer = thread_current ();
+	lock_release (&rwlock->lock);
+}
+
+/* Releases RWLOCK, which the current thread holds for writing.
+   Waiting writers go first, then the readers. */
+void
+rwlock_release_write (struct rwlock *rwlock) {
+	ASSERT (rwlock != NULL);
+
+	lock_acquire (&rwlock->lock);
+	ASSERT (rwlock->writer == thread_current ());
+	rwlock->writer = NULL;
+	if (rwlock->waiting_writer_cnt > 0)
+		cond_signal (&rwlock->writers_ok, &rwlock->lock);
+	else
+		cond_broadcast (&rwlock->readers_ok, &rwlock->lock);
+	lock_release (&rwlock->lock);
+}
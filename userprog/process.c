@@ -192,6 +192,13 @@ __do_fork (void *aux) {
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
 
+	// pending segments are read through the child's own handle
+	if (parent->load_file != NULL) {
+		current->load_file = file_duplicate(parent->load_file);
+		if (current->load_file == NULL)
+			goto error;
+	}
+
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;	
 #else
@@ -441,7 +448,12 @@ process_exit (void) {
 		syscall_close(i);
 	}
 
+	// tear down the address space while the executable is still open,
+	// shared text frames are keyed by its inode
+	supplemental_page_table_kill (&curr->spt);
+
 	file_close(curr->load_file);
+	curr->load_file = NULL;
 	
 	// free fd_table
 	palloc_free_page(curr->fd_table);
@@ -466,7 +478,6 @@ process_exit (void) {
 	// current's pml4 destroy
 	// printf("exit\n");
 	// process_cleanup ();
-	supplemental_page_table_kill (&curr->spt);
 	//
 	// notice parent process
 	sema_up(&curr->wait_sema);
@@ -487,6 +498,11 @@ process_cleanup (void) {
 	supplemental_page_table_kill (&curr->spt);
 #endif
 
+	/* No pending page reads the executable any more.  Close it before
+	 * load() opens the next one, letting it be written again. */
+	file_close (curr->load_file);
+	curr->load_file = NULL;
+
 	uint64_t *pml4;
 	/* Destroy the current process's page directory and switch back
 	 * to the kernel-only page directory. */
@@ -56,6 +56,8 @@ static int add_file_to_fdt(struct file *f);
 static void remove_file_from_fdt(int fd);
 static bool is_stdin(int fd);
 static bool is_stdout(int fd);
+static int read_to_user(struct file *file, void *buffer, unsigned size);
+static int write_from_user(struct file *file, const void *buffer, unsigned size);
 
 
 /* System call.
@@ -84,8 +86,6 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
-	
-	lock_init(&file_rw_lock);
 
 }
 
@@ -314,9 +314,7 @@ int syscall_read(int fd, void *buffer, unsigned size)
 			return -1;
 		}
 
-		lock_acquire(&file_rw_lock);
-		read_result = file_read(find_file_by_fd(fd),buffer,size);
-		lock_release(&file_rw_lock);
+		read_result = read_to_user(find_file_by_fd(fd), buffer, size);
 	}
 
 	return read_result;
@@ -330,7 +328,6 @@ int syscall_write(int fd, const void *buffer, unsigned size)
 	if (is_valid_file_descriptor(fd) == false) return -1;
 
 	int write_result;
-	lock_acquire(&file_rw_lock);
 
 	if(is_stdout(fd))
 	{	
@@ -342,14 +339,13 @@ int syscall_write(int fd, const void *buffer, unsigned size)
 		struct file *file;
 		if((file = find_file_by_fd(fd)) != NULL) {
 			if (!inode_is_dir(file->inode))
-				write_result = file_write(file, buffer,size);
+				write_result = write_from_user(file, buffer, size);
 			else
 				write_result = -1;
 		}
 		else
 			write_result = -1;
 	}
-	lock_release(&file_rw_lock);
 	return write_result;
 }
 
@@ -696,4 +692,55 @@ static bool is_stdout(int fd)
 		return true;
 	else
 		return false;
-}
\ No newline at end of file
+}
+
+// File data is staged through a kernel page instead of being copied
+// straight between the page cache and the user buffer. The cache keeps
+// a slot locked while it copies, so a page fault on the user buffer,
+// which may read a file itself, must not happen at that point.
+// Without a free page the copy goes through a small buffer on the
+// stack, in more steps, rather than failing the call.
+#define BOUNCE_STACK_SIZE 256
+
+static int read_to_user(struct file *file, void *buffer, unsigned size)
+{
+	uint8_t stack_bounce[BOUNCE_STACK_SIZE];
+	uint8_t *page = palloc_get_page(0);
+	uint8_t *bounce = page != NULL ? page : stack_bounce;
+	unsigned bounce_size = page != NULL ? PGSIZE : sizeof stack_bounce;
+	unsigned bytes_read = 0;
+
+	while (bytes_read < size) {
+		unsigned chunk = size - bytes_read < bounce_size ? size - bytes_read : bounce_size;
+		off_t n = file_read(file, bounce, chunk);
+
+		memcpy((uint8_t *)buffer + bytes_read, bounce, n);
+		bytes_read += n;
+		if (n < (off_t)chunk)
+			break;
+	}
+	palloc_free_page(page);
+	return bytes_read;
+}
+
+static int write_from_user(struct file *file, const void *buffer, unsigned size)
+{
+	uint8_t stack_bounce[BOUNCE_STACK_SIZE];
+	uint8_t *page = palloc_get_page(0);
+	uint8_t *bounce = page != NULL ? page : stack_bounce;
+	unsigned bounce_size = page != NULL ? PGSIZE : sizeof stack_bounce;
+	unsigned bytes_written = 0;
+
+	while (bytes_written < size) {
+		unsigned chunk = size - bytes_written < bounce_size ? size - bytes_written : bounce_size;
+		off_t n;
+
+		memcpy(bounce, (const uint8_t *)buffer + bytes_written, chunk);
+		n = file_write(file, bounce, chunk);
+		bytes_written += n;
+		if (n < (off_t)chunk)
+			break;
+	}
+	palloc_free_page(page);
+	return bytes_written;
+}
@@ -3,9 +3,14 @@
 #include "vm/vm.h"
 #include "devices/disk.h"
 // user addition
+#include <string.h>
 #include "threads/vaddr.h"
 #include "lib/kernel/bitmap.h"
+#include "threads/malloc.h"
 #include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/zswap.h"
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in (struct page *page, void *kva);
@@ -23,6 +28,44 @@ static const struct page_operations anon_ops = {
 // user addition
 static struct bitmap *swap_table;
 const size_t SECTORS_IN_PAGE = PGSIZE/DISK_SECTOR_SIZE;
+
+/* Number of pages referring to each swap slot.  Pages that shared a
+ * frame copy-on-write share its slot when it is swapped out. */
+static uint16_t *swap_refs;
+
+/* A swap-out write still on its way to the disk.  The page is
+ * copied aside first so that its frame can be reused at once: the
+ * swap disk has a channel of its own, so the write proceeds while
+ * the faulting thread goes on to read from the file system disk. */
+struct swap_write {
+	struct disk_request req;    /* Writes the copy in REQ.BUFFER. */
+	size_t slot;                /* Swap slot being written. */
+	struct list_elem elem;      /* Element in PENDING_WRITES. */
+};
+
+/* Most swap-out writes in flight at once.  Each holds a kernel
+ * page; past this, swap-out waits for the disk. */
+#define SWAP_WRITE_MAX 32
+
+static struct list pending_writes;
+static size_t pending_cnt;
+
+/* Slot the next swap-out looks at first. */
+static size_t swap_cursor;
+
+/* Thread between anon_swap_plug() and anon_swap_unplug(), if any.
+ * Only kswapd plugs. */
+static struct thread *swap_plugger;
+
+/* Protects SWAP_TABLE, SWAP_REFS, SWAP_CURSOR and PENDING_WRITES. */
+static struct lock swap_lock;
+
+static struct swap_write *swap_write_alloc (void);
+static void swap_write_free (struct swap_write *w);
+static struct swap_write *swap_write_find (size_t slot);
+static void swap_write_done (struct disk_request *r);
+static void swap_slot_put (size_t slot);
+static bool zswap_writeback (void);
 //
 
 
@@ -32,6 +75,14 @@ vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
 	swap_disk = disk_get(1, 1);
 	swap_table = bitmap_create(disk_size(swap_disk)/SECTORS_IN_PAGE);
+	if (swap_table == NULL)
+		PANIC("swap table init failed");
+	swap_refs = calloc(bitmap_size(swap_table), sizeof *swap_refs);
+	if (swap_refs == NULL)
+		PANIC("swap table init failed");
+	zswap_init(bitmap_size(swap_table));
+	list_init(&pending_writes);
+	lock_init(&swap_lock);
 }
 
 /* Initialize the file mapping */
@@ -54,36 +105,65 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	// printf("swap in\n");
-	struct anon_page *anon_page = &page->anon;
-
-	if (bitmap_test(swap_table, anon_page->swap_idx) == false) {
-		return false;
-	}
-	for (int i = 0; i < SECTORS_IN_PAGE; i++) {
-		disk_read(swap_disk, anon_page->swap_idx * SECTORS_IN_PAGE + i, kva + DISK_SECTOR_SIZE * i);
-	}
-	bitmap_set(swap_table, anon_page->swap_idx, false);
-	anon_page->swap_idx = -1;
-	return true; 
+	ASSERT(page->frame != NULL && page->frame->kva == kva);
+	return anon_swap_in_cluster(&page, 1);
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	struct swap_write *w;
 	size_t bitmap_idx;
-	bitmap_idx = bitmap_scan_and_flip(swap_table, 0, 1, false);
+
+	lock_acquire(&swap_lock);
+	/* Next fit, so that pages swapped out one after another land in
+	 * neighbouring slots, to be written and read back together. */
+	bitmap_idx = bitmap_scan_and_flip(swap_table, swap_cursor, 1, false);
+	if (bitmap_idx == BITMAP_ERROR)
+		bitmap_idx = bitmap_scan_and_flip(swap_table, 0, 1, false);
+	if (bitmap_idx != BITMAP_ERROR) {
+		swap_cursor = bitmap_idx + 1;
+		swap_refs[bitmap_idx] = 1;
+	}
+	lock_release(&swap_lock);
 
 	if (bitmap_idx == BITMAP_ERROR) {
 		// error handling
 		return false;
 	}
 
-	for (int i = 0; i < SECTORS_IN_PAGE; i++) {
-		disk_write(swap_disk, 
-				   bitmap_idx * SECTORS_IN_PAGE + i, 
-				   page->frame->kva + DISK_SECTOR_SIZE * i);
+	/* Keep it in memory, compressed, if it shrinks well.  The slot
+	 * stays reserved, so nothing else changes for the page.  A full
+	 * pool writes its oldest pages to their slots first. */
+	while (zswap_full() && zswap_writeback())
+		continue;
+	if (zswap_store(bitmap_idx, page->frame->kva))
+		goto done;
+
+	w = swap_write_alloc();
+	if (w != NULL) {
+		lock_acquire(&swap_lock);
+		w->slot = bitmap_idx;
+		list_push_back(&pending_writes, &w->elem);
+		lock_release(&swap_lock);
+		memcpy(w->req.buffer, page->frame->kva, PGSIZE);
+		disk_request_init(&w->req, swap_disk, bitmap_idx * SECTORS_IN_PAGE,
+				SECTORS_IN_PAGE, w->req.buffer, true);
+		w->req.callback = swap_write_done;
+		w->req.aux = w;
+		disk_submit(&w->req);
+	} else {
+		/* Waiting for a write held back by our own plug would wait
+		 * forever. */
+		bool plugged = swap_plugger == thread_current();
+		if (plugged)
+			disk_unplug(swap_disk);
+		disk_write_multi(swap_disk, bitmap_idx * SECTORS_IN_PAGE,
+				SECTORS_IN_PAGE, page->frame->kva);
+		if (plugged)
+			disk_plug(swap_disk);
 	}
+done:
 	page->anon.swap_idx = bitmap_idx;
 	// printf("anon swap out: %d\n", bitmap_idx);
 	pml4_clear_page(page->t->pml4, page->va);
@@ -96,5 +176,233 @@ anon_swap_out (struct page *page) {
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	if (anon_page->swap_idx != (size_t) -1) {
+		swap_slot_put(anon_page->swap_idx);
+		anon_page->swap_idx = -1;
+	}
 	return; 
 }
+
+// user addition
+/* Swaps in the CNT anonymous pages in PAGES, each into the frame
+ * it has been given.  The reads are queued together, so that the
+ * disk merges those of neighbouring slots into one transfer: pages
+ * swapped out together come back in one.  Returns false, having
+ * read nothing, if some page has no valid slot. */
+bool
+anon_swap_in_cluster (struct page **pages, size_t cnt) {
+	struct disk_request *reqs;
+	bool from_disk[ANON_CLUSTER_MAX];
+	size_t i;
+
+	ASSERT(cnt <= ANON_CLUSTER_MAX);
+
+	lock_acquire(&swap_lock);
+	for (i = 0; i < cnt; i++)
+		if (pages[i]->anon.swap_idx == (size_t) -1
+				|| !bitmap_test(swap_table, pages[i]->anon.swap_idx)) {
+			lock_release(&swap_lock);
+			return false;
+		}
+
+	lock_release(&swap_lock);
+
+	/* Our references keep the slots from being reused meanwhile.
+	 * The compressed copies go first: one written back meanwhile is
+	 * among the pending writes before it leaves the pool. */
+	for (i = 0; i < cnt; i++)
+		from_disk[i] = !zswap_load(pages[i]->anon.swap_idx, pages[i]->frame->kva);
+
+	/* Take the copies of slots still being written out. */
+	lock_acquire(&swap_lock);
+	for (i = 0; i < cnt; i++) {
+		struct swap_write *w;
+		if (!from_disk[i])
+			continue;
+		w = swap_write_find(pages[i]->anon.swap_idx);
+		if (w != NULL)
+			memcpy(pages[i]->frame->kva, w->req.buffer, PGSIZE);
+		from_disk[i] = w == NULL;
+	}
+	lock_release(&swap_lock);
+
+	reqs = malloc(cnt * sizeof *reqs);
+	if (reqs != NULL)
+		disk_plug(swap_disk);
+	for (i = 0; i < cnt; i++) {
+		if (!from_disk[i])
+			continue;
+		if (reqs != NULL) {
+			disk_request_init(&reqs[i], swap_disk,
+					pages[i]->anon.swap_idx * SECTORS_IN_PAGE, SECTORS_IN_PAGE,
+					pages[i]->frame->kva, false);
+			disk_submit(&reqs[i]);
+		} else {
+			/* Out of memory: read them one at a time. */
+			disk_read_multi(swap_disk, pages[i]->anon.swap_idx * SECTORS_IN_PAGE,
+					SECTORS_IN_PAGE, pages[i]->frame->kva);
+		}
+	}
+	if (reqs != NULL) {
+		disk_unplug(swap_disk);
+		for (i = 0; i < cnt; i++)
+			if (from_disk[i])
+				disk_wait(&reqs[i]);
+		free(reqs);
+	}
+
+	for (i = 0; i < cnt; i++) {
+		swap_slot_put(pages[i]->anon.swap_idx);
+		pages[i]->anon.swap_idx = -1;
+	}
+	return true;
+}
+
+/* Holds back swap writes from now until anon_swap_unplug(), so
+ * that those of a batch of pages reach the disk together and the
+ * ones to neighbouring slots merge. */
+void
+anon_swap_plug (void) {
+	ASSERT(swap_plugger == NULL);
+	swap_plugger = thread_current();
+	disk_plug(swap_disk);
+}
+
+/* Undoes anon_swap_plug(). */
+void
+anon_swap_unplug (void) {
+	ASSERT(swap_plugger == thread_current());
+	swap_plugger = NULL;
+	disk_unplug(swap_disk);
+}
+
+/* Makes PAGE, a copy of an anonymous page, refer to the swap slot
+ * SLOT as well, or to no slot if SLOT is -1. */
+void
+anon_swap_share (struct page *page, size_t slot) {
+	ASSERT(VM_TYPE(page->operations->type) == VM_ANON);
+
+	page->anon.swap_idx = slot;
+	if (slot == (size_t) -1)
+		return;
+	lock_acquire(&swap_lock);
+	ASSERT(swap_refs[slot] > 0 && swap_refs[slot] < UINT16_MAX);
+	swap_refs[slot]++;
+	lock_release(&swap_lock);
+}
+//
+
+// user addition
+/* Returns a swap_write with a kernel page to copy into, counted
+ * in PENDING_CNT, or NULL if too many writes are in flight or
+ * memory is short. */
+static struct swap_write *
+swap_write_alloc (void) {
+	struct swap_write *w;
+
+	lock_acquire(&swap_lock);
+	if (pending_cnt >= SWAP_WRITE_MAX) {
+		lock_release(&swap_lock);
+		return NULL;
+	}
+	pending_cnt++;
+	lock_release(&swap_lock);
+
+	w = malloc(sizeof *w);
+	if (w != NULL) {
+		w->req.buffer = palloc_get_page(0);
+		if (w->req.buffer != NULL)
+			return w;
+	}
+	swap_write_free(w);
+	return NULL;
+}
+
+/* Frees W, which may be NULL or lack its page, and uncounts it
+ * from PENDING_CNT. */
+static void
+swap_write_free (struct swap_write *w) {
+	lock_acquire(&swap_lock);
+	pending_cnt--;
+	lock_release(&swap_lock);
+	if (w != NULL) {
+		palloc_free_page(w->req.buffer);
+		free(w);
+	}
+}
+
+/* Writes the oldest page of the zswap pool back to its swap slot,
+ * to make room in the pool.  Returns false if there is nothing to
+ * write or no swap_write for it.  The page moves from the pool to
+ * PENDING_WRITES under SWAP_LOCK, so a swap-in that looks in the
+ * pool first and then in PENDING_WRITES finds it in one or the
+ * other, or on the disk. */
+static bool
+zswap_writeback (void) {
+	struct swap_write *w = swap_write_alloc();
+
+	if (w == NULL)
+		return false;
+	lock_acquire(&swap_lock);
+	if (!zswap_evict(&w->slot, w->req.buffer)) {
+		lock_release(&swap_lock);
+		swap_write_free(w);
+		return false;
+	}
+	list_push_back(&pending_writes, &w->elem);
+	lock_release(&swap_lock);
+
+	disk_request_init(&w->req, swap_disk, w->slot * SECTORS_IN_PAGE,
+			SECTORS_IN_PAGE, w->req.buffer, true);
+	w->req.callback = swap_write_done;
+	w->req.aux = w;
+	disk_submit(&w->req);
+	return true;
+}
+
+/* Returns the write in flight to SLOT, or NULL.  Must be called
+ * with SWAP_LOCK held. */
+static struct swap_write *
+swap_write_find (size_t slot) {
+	struct list_elem *e;
+
+	ASSERT(lock_held_by_current_thread(&swap_lock));
+	for (e = list_begin(&pending_writes); e != list_end(&pending_writes);
+			e = list_next(e)) {
+		struct swap_write *w = list_entry(e, struct swap_write, elem);
+		if (w->slot == slot)
+			return w;
+	}
+	return NULL;
+}
+
+/* Completion callback of a swap-out write, run by the swap
+ * channel's worker. */
+static void
+swap_write_done (struct disk_request *r) {
+	struct swap_write *w = r->aux;
+
+	lock_acquire(&swap_lock);
+	list_remove(&w->elem);
+	if (swap_refs[w->slot] == 0)
+		bitmap_set(swap_table, w->slot, false);
+	lock_release(&swap_lock);
+	swap_write_free(w);
+}
+
+/* Drops a reference to SLOT, and frees it with the last one.  If
+ * it is still being written, the write frees it when done, so a
+ * new write to the slot cannot overtake the old one in the disk
+ * queue. */
+static void
+swap_slot_put (size_t slot) {
+	lock_acquire(&swap_lock);
+	ASSERT(swap_refs[slot] > 0);
+	if (--swap_refs[slot] == 0) {
+		zswap_drop(slot);
+		if (swap_write_find(slot) == NULL)
+			bitmap_set(swap_table, slot, false);
+	}
+	lock_release(&swap_lock);
+}
+//
@@ -70,8 +70,11 @@ static bool
 file_backed_swap_out (struct page *page) {
 
 	struct file_page *file_page = &page->file;
-	if (!pml4_is_dirty(thread_current()->pml4, page->va)) {
-		pml4_clear_page(thread_current()->pml4, page->va);
+	/* The owner's page table: this may run in another thread, such
+	 * as kswapd. */
+	uint64_t *pml4 = page->t->pml4;
+	if (!vm_frame_test_dirty(page->frame, false)) {
+		pml4_clear_page(pml4, page->va);
 		page->frame->page = NULL;
 		page->frame = NULL;
 		return true; 
@@ -83,20 +86,33 @@ file_backed_swap_out (struct page *page) {
 					  file_page->file_offset) != file_page->length) {
 		return false;
 	}
-	pml4_clear_page(thread_current()->pml4, page->va);
+	pml4_clear_page(pml4, page->va);
 	page->frame->page = NULL;
 	page->frame = NULL;
 	return true;
 }
 
+/* Writes PAGE back to its file if it is dirty, leaving it mapped
+ * and clean, so that evicting it later needs no write. */
+bool
+file_backed_writeback (struct page *page) {
+	struct file_page *file_page = &page->file;
+
+	/* Clear the bits first, so a write that races with ours marks the
+	 * page dirty again. */
+	if (!vm_frame_test_dirty(page->frame, true))
+		return true;
+	return file_write_at(file_page->file, page->frame->kva,
+			file_page->length, file_page->file_offset) == (off_t) file_page->length;
+}
+
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page = &page->file;
-	if (pml4_is_dirty(thread_current()->pml4, page->va)) {
-		// content write back
-		do_munmap(file_page->mmap_addr); 
-	}
+	// content write back, while the mappings are still in place; the
+	// frame is off the frame table, or gone if it was shared
+	if (page->frame != NULL)
+		file_backed_writeback(page);
 }
 
 /* Do the mmap */
@@ -137,20 +153,18 @@ do_munmap (void *addr) {
 	ASSERT(VM_TYPE(page_get_type(page)) == VM_FILE);
 
 	// Then page is first page of mmap file
-	struct file *file = page->file.file;
 	int number_of_pages = page->file.number_of_pages;
 
 	for (int i = 0; i < number_of_pages; i++) {
 		struct page *next_page = spt_find_page(&curr->spt, addr + PGSIZE * i);
 		
-		if (pml4_is_dirty(curr->pml4, next_page->va)) {
-			ASSERT(next_page->file.length == file_write_at(file, 
-														   next_page->va, 
-														   next_page->file.length, 
-														   next_page->file.file_offset));
-			pml4_set_dirty(curr->pml4, next_page->va, false);
-		}
-
+		// never loaded: nothing to write back
+		if (next_page == NULL
+				|| VM_TYPE(next_page->operations->type) != VM_FILE)
+			continue;
+		// checks every mapping of the frame, and writes from its kernel
+		// address, so it does not matter which process maps it
+		vm_writeback_page(next_page);
 	}
 
 	return;
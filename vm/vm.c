@@ -7,9 +7,104 @@
 // addition
 #include "lib/kernel/hash.h" 
 #include "threads/mmu.h"
+#include "threads/synch.h"
 #include "filesys/page_cache.h"
+#include "filesys/inode.h"
+#include "userprog/process.h"
+#include "vm/zswap.h"
+#include <stdio.h>
+#include <string.h>
 struct list frame_table;
 
+/* Protects FRAME_TABLE, CLOCK_HAND, the free frame pool and the
+ * BUSY, PAGE and PAGES members of every frame.  Frames are in
+ * FRAME_TABLE only while they may be evicted: not while their page
+ * is being loaded or evicted.  BUSY is an exclusive hold on a frame,
+ * not a count: the evictor, kswapd cleaning it and a thread pinning
+ * it to copy it all set it, and anyone else who needs the frame
+ * waits on BUSY_DONE.  The clock skips busy frames. */
+static struct lock frame_lock;
+static struct condition busy_done;      /* Signaled when BUSY is cleared. */
+static struct list_elem *clock_hand;    /* Next frame the clock looks at. */
+
+/* One frame for each page of the user pool, indexed by its page
+ * number in the pool.  vm_init() takes every page of the pool, so
+ * frames are never allocated or freed, only moved between
+ * FRAME_TABLE and FREE_FRAMES. */
+static struct frame *frames;
+static size_t frame_total;              /* Usable frames in FRAMES. */
+
+/* Frames with no page, either never used yet or emptied by kswapd
+ * ahead of demand. */
+static struct list free_frames;
+static size_t free_cnt;
+
+/* kswapd refills FREE_FRAMES to the high watermark once a page
+ * fault finds it below the low one.  The watermarks scale with the
+ * memory in use, up to KSWAPD_HIGH frames, evicting KSWAPD_BATCH
+ * frames at a time.  It also cleans up to KSWAPD_CLEAN dirty
+ * file-backed pages ahead of the clock hand. */
+#define KSWAPD_HIGH 32
+#define KSWAPD_BATCH 8
+#define KSWAPD_CLEAN 16
+static struct condition kswapd_cond;    /* Signaled to wake kswapd. */
+static bool reclaim_wanted;             /* Has a fault asked for frames? */
+
+/* Frames holding read-only pages of executables, by inode and
+ * offset, so that every process running a program maps the same
+ * copy of its text.  A frame is in TEXT_FRAMES only while it is in
+ * FRAME_TABLE.  Protected by FRAME_LOCK. */
+static struct hash text_frames;
+
+/* Page replacement policy, set by -vm-evict=. */
+enum vm_evict_policy vm_evict_policy = VM_EVICT_CLOCK;
+
+/* Statistics. */
+static long long fault_cnt, evict_cnt, direct_evict_cnt, text_share_cnt;
+static long long fault_around_cnt, swap_cluster_cnt, zero_map_cnt;
+
+/* A page of zeroes, mapped read-only wherever a process reads
+ * anonymous memory it has not written yet.  It is not a frame: it
+ * is never evicted, and writing to it takes the copy-on-write path
+ * to a frame of the page's own. */
+static void *zero_page;
+
+/* Pages vm_fault_around() loads at most per fault, counting the
+ * faulting one.  A power of 2. */
+#define FAULT_AROUND 8
+
+/* Pages vm_swap_in_cluster() swaps in at most per fault. */
+#define SWAP_CLUSTER ANON_CLUSTER_MAX
+
+static void frame_table_insert (struct frame *frame);
+static void frame_table_remove (struct frame *frame);
+static void frame_link (struct frame *frame, struct page *page);
+static void frame_unlink (struct frame *frame, struct page *page);
+static bool frame_swap_out (struct frame *frame);
+static struct frame *page_pin_frame (struct page *page);
+static bool page_wait_eviction (struct page *page);
+static void frame_set_writable (struct frame *frame, bool writable);
+static void frame_unpin (struct frame *frame);
+static void frames_init (void);
+static struct frame *frame_of (void *kva);
+static struct frame *frame_alloc (bool reserve);
+static void frame_free (struct frame *frame);
+static bool page_is_zero_fill (struct page *page);
+static bool page_text_key (struct page *page, struct frame *key);
+static bool text_frame_claim (struct page *page);
+static struct frame *vm_try_get_frame (void);
+static bool vm_load_page (struct page *page, struct frame *frame);
+static struct file *pending_file (struct page *page);
+static void vm_fault_around (struct page *page, struct file *file);
+static bool vm_map_frame (struct page *page, struct frame *frame);
+static void vm_unmap_frame (struct page *page);
+static bool vm_swap_in_cluster (struct page *page);
+static uint64_t text_hash_func (const struct hash_elem *e, void *aux);
+static bool text_less_func (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+static size_t high_watermark (void);
+static size_t low_watermark (void);
+static void kswapd (void *aux);
 //
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
@@ -25,6 +120,17 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init(&frame_table);
+	lock_init(&frame_lock);
+	cond_init(&busy_done);
+	clock_hand = list_end(&frame_table);
+	hash_init(&text_frames, text_hash_func, text_less_func, NULL);
+	zero_page = palloc_get_page(PAL_ZERO);
+	if (zero_page == NULL)
+		PANIC("zero page allocation failed");
+	frames_init();
+	cond_init(&kswapd_cond);
+	if (thread_create("kswapd", PRI_DEFAULT, kswapd, NULL) == TID_ERROR)
+		PANIC("kswapd creation failed");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -45,6 +151,10 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static void spt_page_free (struct hash_elem *e, void *aux);
+static struct page *page_clone (struct supplemental_page_table *dst,
+		struct page *src);
+static bool uninit_aux_dup (struct page *page, struct page *src);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -119,16 +229,107 @@ spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Returns true if the page in FRAME was accessed through any of
+ * its mappings since the last call, and clears the accessed bits. */
+static bool
+frame_test_and_clear_accessed (struct frame *frame) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages);
+			e = list_next(e)) {
+		struct page *page = list_entry(e, struct page, pages_elem);
+		if (pml4_is_accessed(page->t->pml4, page->va)) {
+			pml4_set_accessed(page->t->pml4, page->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Returns true if the page in FRAME was written through any of its
+ * mappings, and clears the dirty bits as well if CLEAR is true.
+ * FRAME's mappings must not change meanwhile: FRAME_LOCK must be
+ * held, or FRAME pinned or off the frame table. */
+bool
+vm_frame_test_dirty (struct frame *frame, bool clear) {
+	bool dirty = false;
+	struct list_elem *e;
+
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages);
+			e = list_next(e)) {
+		struct page *page = list_entry(e, struct page, pages_elem);
+		if (pml4_is_dirty(page->t->pml4, page->va)) {
+			if (clear)
+				pml4_set_dirty(page->t->pml4, page->va, false);
+			dirty = true;
+		}
+	}
+	return dirty;
+}
+
+/* Writes PAGE, a file-backed page, back to its file if it is in
+ * memory and was written through any mapping of its frame.  The
+ * frame is pinned meanwhile.  Returns false if the write fails. */
+bool
+vm_writeback_page (struct page *page) {
+	struct frame *frame;
+	bool success;
+
+	lock_acquire(&frame_lock);
+	frame = page_pin_frame(page);
+	lock_release(&frame_lock);
+	if (frame == NULL)
+		return true;
+
+	success = file_backed_writeback(page);
+
+	lock_acquire(&frame_lock);
+	frame_unpin(frame);
+	lock_release(&frame_lock);
+	return success;
+}
+
+/* Get the struct frame, that will be evicted.  Takes it out of the
+ * frame table.  Must be called with FRAME_LOCK held. */
 static struct frame *
 vm_get_victim (void) {
 	struct frame *victim = NULL;
 	 /* TODO: The policy for eviction is up to you. */
-	
-	// FIFO
-	struct list_elem *e = list_pop_front(&frame_table);
-	victim = list_entry(e, struct frame, ft_elem);
-	
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (list_empty(&frame_table))
+		return NULL;
+
+	if (vm_evict_policy == VM_EVICT_FIFO) {
+		struct list_elem *e;
+		for (e = list_begin(&frame_table); e != list_end(&frame_table);
+				e = list_next(e)) {
+			victim = list_entry(e, struct frame, ft_elem);
+			if (!victim->busy)
+				break;
+			victim = NULL;
+		}
+	} else {
+		/* Clock: sweep from the hand, giving each recently used frame a
+		 * second chance.  Two sweeps find a victim, since the first
+		 * clears every accessed bit. */
+		struct frame *candidate = NULL;
+		/* list_size() walks the list, so count it once. */
+		size_t sweep = 2 * list_size(&frame_table);
+		for (size_t i = 0; i <= sweep; i++) {
+			if (clock_hand == list_end(&frame_table))
+				clock_hand = list_begin(&frame_table);
+			candidate = list_entry(clock_hand, struct frame, ft_elem);
+			clock_hand = list_next(clock_hand);
+			if (candidate->busy)
+				continue;
+			victim = candidate;
+			if (!frame_test_and_clear_accessed(victim))
+				break;
+		}
+	}
+	if (victim != NULL)
+		frame_table_remove(victim);
 	return victim;
 }
 
@@ -136,13 +337,238 @@ vm_get_victim (void) {
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim = vm_get_victim ();
+	struct frame *victim;
+	bool success;
+
+	lock_acquire(&frame_lock);
+	victim = vm_get_victim ();
+	if (victim != NULL) {
+		victim->busy = true;
+		evict_cnt++;
+	}
+	lock_release(&frame_lock);
+	if (victim == NULL)
+		return NULL;
+
 	/* TODO: swap out the victim and return the evicted frame. */
-	if (swap_out(victim->page)) {
-		return victim;
+	success = frame_swap_out(victim);
+
+	lock_acquire(&frame_lock);
+	victim->busy = false;
+	if (!success)
+		frame_table_insert(victim);
+	cond_broadcast(&busy_done, &frame_lock);
+	lock_release(&frame_lock);
+	return success ? victim : NULL;
+}
+
+/* Makes FRAME an eviction candidate, just behind the clock hand,
+ * that is, where it will be looked at last.  Must be called with
+ * FRAME_LOCK held. */
+static void
+frame_table_insert (struct frame *frame) {
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	list_insert(clock_hand, &frame->ft_elem);
+}
+
+/* Takes FRAME out of the frame table.  Must be called with
+ * FRAME_LOCK held. */
+static void
+frame_table_remove (struct frame *frame) {
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (clock_hand == &frame->ft_elem)
+		clock_hand = list_next(clock_hand);
+	list_remove(&frame->ft_elem);
+	if (frame->text_inode != NULL) {
+		hash_delete(&text_frames, &frame->text_elem);
+		/* Never the last reference: the pages mapping the frame
+		 * belong to processes that still hold the executable open. */
+		inode_close(frame->text_inode);
+		frame->text_inode = NULL;
 	}
-	return NULL;
+}
+
+/* Maps PAGE to FRAME in the frame's books.  The first page linked
+ * is the one whose operations swap the frame in and out. */
+static void
+frame_link (struct frame *frame, struct page *page) {
+	if (frame->page == NULL)
+		frame->page = page;
+	list_push_back(&frame->pages, &page->pages_elem);
+	page->frame = frame;
+}
+
+/* Undoes frame_link(), handing the swapping over to another page
+ * that shares FRAME.  Must be called with FRAME_LOCK held. */
+static void
+frame_unlink (struct frame *frame, struct page *page) {
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	ASSERT(page->frame == frame);
 
+	list_remove(&page->pages_elem);
+	page->frame = NULL;
+	if (frame->page == page)
+		frame->page = list_empty(&frame->pages) ? NULL
+			: list_entry(list_front(&frame->pages), struct page, pages_elem);
+}
+
+/* Swaps out the page in FRAME, along with every page sharing it
+ * copy-on-write.  Those are clean, or they could not be sharing
+ * the frame: an anonymous one just refers to the same swap slot,
+ * a file-backed one is read back from its file.  FRAME must be off
+ * the frame table. */
+static bool
+frame_swap_out (struct frame *frame) {
+	struct page *page = frame->page;
+
+	/* The owners may be running meanwhile, kswapd being a thread of
+	 * its own: write-protect every mapping before the contents are
+	 * copied out, or a store that lands after the copy is lost.  Such
+	 * a store faults and waits for the eviction to end. */
+	frame_set_writable(frame, false);
+	if (!swap_out(page)) {
+		frame_set_writable(frame, true);
+		return false;
+	}
+
+	while (!list_empty(&frame->pages)) {
+		struct page *other = list_entry(list_pop_front(&frame->pages),
+				struct page, pages_elem);
+		other->is_needed_to_cow = false;
+		if (other == page)
+			continue;
+		pml4_clear_page(other->t->pml4, other->va);
+		other->frame = NULL;
+		if (VM_TYPE(other->operations->type) == VM_ANON)
+			anon_swap_share(other, page->anon.swap_idx);
+	}
+	frame->page = NULL;
+	return true;
+}
+
+/* Waits until PAGE's frame, if it has one, is not being evicted or
+ * otherwise worked on, then pins it, so that it stays put until
+ * frame_unpin().  Returns the frame, or NULL if PAGE is not in
+ * memory.  Must be called with FRAME_LOCK held. */
+static struct frame *
+page_pin_frame (struct page *page) {
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	while (page->frame != NULL && page->frame->busy)
+		cond_wait(&busy_done, &frame_lock);
+	if (page->frame != NULL)
+		page->frame->busy = true;
+	return page->frame;
+}
+
+/* Waits until PAGE's frame, if it has one, is not being evicted or
+ * otherwise worked on.  Returns true if it had to wait. */
+static bool
+page_wait_eviction (struct page *page) {
+	bool waited = false;
+
+	lock_acquire(&frame_lock);
+	while (page->frame != NULL && page->frame->busy) {
+		cond_wait(&busy_done, &frame_lock);
+		waited = true;
+	}
+	lock_release(&frame_lock);
+	return waited;
+}
+
+/* Write-protects every mapping of FRAME, or, if WRITABLE is true,
+ * gives the write permission back to the mappings that had it.
+ * FRAME's mappings must not change meanwhile. */
+static void
+frame_set_writable (struct frame *frame, bool writable) {
+	struct list_elem *e;
+
+	for (e = list_begin(&frame->pages); e != list_end(&frame->pages);
+			e = list_next(e)) {
+		struct page *page = list_entry(e, struct page, pages_elem);
+		pml4_set_writable(page->t->pml4, page->va,
+				writable && page->writable && !page->is_needed_to_cow);
+	}
+}
+
+/* Unpins FRAME.  Must be called with FRAME_LOCK held. */
+static void
+frame_unpin (struct frame *frame) {
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+
+	frame->busy = false;
+	cond_broadcast(&busy_done, &frame_lock);
+}
+
+/* Takes every page of the user pool into FRAMES and FREE_FRAMES. */
+static void
+frames_init (void) {
+	size_t slots = palloc_user_page_cnt();
+	void *kva;
+	// 0x4000000 ~ 0x80040000 유저영역
+	// 0x800400000 ~ 끝 커널
+	// kva 0x80040000 + 0x123 == physical memeory 0x123
+
+	frames = calloc(slots, sizeof *frames);
+	if (frames == NULL)
+		PANIC("frame table allocation failed");
+	list_init(&free_frames);
+	while ((kva = palloc_get_page(PAL_USER)) != NULL) {
+		struct frame *frame = frame_of(kva);
+		frame->kva = kva;
+		list_push_back(&free_frames, &frame->ft_elem);
+		free_cnt++;
+	}
+	frame_total = free_cnt;
+}
+
+/* Returns the frame of KVA, a page of the user pool. */
+static struct frame *
+frame_of (void *kva) {
+	return &frames[palloc_user_page_no(kva)];
+}
+
+/* Takes a frame off FREE_FRAMES and readies it for a page.  Unless
+ * RESERVE is true, leaves alone the frames below the low watermark,
+ * which kswapd keeps for faults.  Returns NULL if there is none to
+ * take.  Must be called with FRAME_LOCK held. */
+static struct frame *
+frame_alloc (bool reserve) {
+	struct frame *frame;
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (list_empty(&free_frames) || (!reserve && free_cnt <= low_watermark()))
+		return NULL;
+	frame = list_entry(list_pop_front(&free_frames), struct frame, ft_elem);
+	free_cnt--;
+
+	frame->page = NULL;
+	list_init(&frame->pages);
+	frame->text_inode = NULL;
+	frame->busy = false;
+	return frame;
+}
+
+/* Puts FRAME, which no page maps, back on FREE_FRAMES. */
+static void
+frame_free (struct frame *frame) {
+	lock_acquire(&frame_lock);
+	list_push_front(&free_frames, &frame->ft_elem);
+	free_cnt++;
+	lock_release(&frame_lock);
+}
+
+/* Returns a free frame, or NULL if only kswapd's reserve is left.
+ * For pages loaded on speculation, which should not cause
+ * eviction. */
+static struct frame *
+vm_try_get_frame (void) {
+	struct frame *frame;
+
+	lock_acquire(&frame_lock);
+	frame = frame_alloc(false);
+	lock_release(&frame_lock);
+	return frame;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
@@ -151,33 +577,37 @@ vm_evict_frame (void) {
  * space.*/
 static struct frame *
 vm_get_frame (void) {
-	struct frame *frame = (struct frame*)malloc(sizeof(struct frame));
 	/* TODO: Fill this function. */
+	struct frame *frame;
 
-	void *addr_new_allocated_page = palloc_get_page(PAL_USER);
-	// 0x4000000 ~ 0x80040000 유저영역
-	// 0x800400000 ~ 끝 커널
-	// kva 0x80040000 + 0x123 == physical memeory 0x123
+	/* Take a free frame, and have kswapd free more before they run
+	 * out. */
+	lock_acquire(&frame_lock);
+	frame = frame_alloc(true);
+	if (free_cnt < low_watermark() && !reclaim_wanted) {
+		reclaim_wanted = true;
+		cond_signal(&kswapd_cond, &frame_lock);
+	}
+	if (frame == NULL)
+		direct_evict_cnt++;
+	lock_release(&frame_lock);
 
 	// no available page
-	if (addr_new_allocated_page == NULL){
-		free(frame);
-		struct frame *evicted_frame = vm_evict_frame();
-		// evict the page
-		// if (evicted_frame == NULL) {
-		// 	//error
-		// 	return NULL;
-		// }
-		ASSERT(evicted_frame != NULL);
-
-		list_push_back(&frame_table, &evicted_frame->ft_elem);
-		return evicted_frame;
-		// USERTODO
-	}
-	frame->kva = addr_new_allocated_page;
-	frame->page = NULL;
+	while (frame == NULL) {
+
+		/* None left: evict one here. */
+		frame = vm_evict_frame();
+		if (frame != NULL)
+			break;
 
-	list_push_back(&frame_table, &frame->ft_elem);
+		/* Every frame is pinned or in kswapd's batch.  Wait for one
+		 * of them to be let go, then look at the free list again. */
+		lock_acquire(&frame_lock);
+		frame = frame_alloc(true);
+		if (frame == NULL)
+			cond_wait(&busy_done, &frame_lock);
+		lock_release(&frame_lock);
+	}
 	
 	ASSERT (frame != NULL);
 	ASSERT (frame->page == NULL);
@@ -196,7 +626,47 @@ vm_stack_growth (void *addr) {
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	struct frame *frame, *copy;
+
+	/* Never written: give it a frame of its own instead of the zero
+	 * page. */
+	if (VM_TYPE(page->operations->type) == VM_UNINIT) {
+		pml4_clear_page(page->t->pml4, page->va);
+		page->is_needed_to_cow = false;
+		return vm_do_claim_page(page);
+	}
+
+	lock_acquire(&frame_lock);
+	frame = page_pin_frame(page);
+	if (frame == NULL) {
+		/* Swapped out meanwhile; it faults back in as a private copy. */
+		lock_release(&frame_lock);
+		return true;
+	}
+	if (list_size(&frame->pages) == 1) {
+		/* The others are gone: no need to copy. */
+		pml4_set_page(page->t->pml4, page->va, frame->kva, true);
+		page->is_needed_to_cow = false;
+		frame_unpin(frame);
+		lock_release(&frame_lock);
+		return true;
+	}
+	lock_release(&frame_lock);
+
+	/* Copy while FRAME is pinned, then break away from it. */
+	copy = vm_get_frame();
+	memcpy(copy->kva, frame->kva, PGSIZE);
+
+	lock_acquire(&frame_lock);
+	frame_unlink(frame, page);
+	frame_unpin(frame);
+	frame_link(copy, page);
+	page->is_needed_to_cow = false;
+	pml4_set_page(page->t->pml4, page->va, copy->kva, true);
+	frame_table_insert(copy);
+	lock_release(&frame_lock);
+	return true;
 }
 
 /* Return true on success */
@@ -205,6 +675,7 @@ vm_try_handle_fault (struct intr_frame *f, void *addr,
 		bool user, bool write, bool not_present) {
 	struct supplemental_page_table *spt = &thread_current ()->spt;
 	struct page *page = NULL;
+	struct file *file;
 	// printf("vm try handle fault\n");
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
@@ -239,7 +710,85 @@ vm_try_handle_fault (struct intr_frame *f, void *addr,
 	// printf("page: %p type: %d va: %p writable: %d\n",page, page->type, page->va, page->writable);
 	// write && read_only => false
 	if (write && !page->writable) return false;
-	return vm_do_claim_page (page);
+
+	// its frame is being evicted, and was write-protected or unmapped
+	// for that: try again once the eviction is over
+	if (page_wait_eviction (page))
+		return true;
+
+	// write to a page shared copy-on-write
+	if (!not_present) {
+		if (write && page->is_needed_to_cow)
+			return vm_handle_wp (page);
+		return false;
+	}
+	fault_cnt++;
+
+	// reading memory never written: map the shared zero page
+	if (!write && page_is_zero_fill (page)
+			&& pml4_set_page (page->t->pml4, page->va, zero_page, false)) {
+		page->is_needed_to_cow = page->writable;
+		zero_map_cnt++;
+		return true;
+	}
+	if (VM_TYPE(page->operations->type) == VM_ANON
+			&& page->anon.swap_idx != (size_t) -1)
+		return vm_swap_in_cluster (page);
+	file = pending_file (page);
+	if (!vm_do_claim_page (page))
+		return false;
+	if (file != NULL)
+		vm_fault_around (page, file);
+	return true;
+}
+
+/* Returns the file pending page PAGE is to be read from, or NULL
+ * if PAGE is not a pending page of an executable or a mapping. */
+static struct file *
+pending_file (struct page *page) {
+	void *aux = page->uninit.aux;
+
+	if (VM_TYPE(page->operations->type) != VM_UNINIT || aux == NULL)
+		return NULL;
+	if (page->uninit.init == lazy_load_segment_file)
+		return ((struct Inform_mmap_file *) aux)->file;
+	if (VM_TYPE(page->uninit.type) == VM_ANON)
+		return ((struct Inform_load_file *) aux)->file;
+	return NULL;
+}
+
+/* Loads the pending pages of FILE in the FAULT_AROUND-page aligned
+ * window around PAGE, which was just faulted in from FILE, so that
+ * a sequential scan takes one fault per window rather than one per
+ * page.  They are read ahead on speculation, so this only takes
+ * frames that are free, never evicting for them; and their accessed
+ * bits start clear, so the clock takes them first if unused. */
+static void
+vm_fault_around (struct page *page, struct file *file) {
+	struct supplemental_page_table *spt = &page->t->spt;
+	uint8_t *start = (uint8_t *) ((uint64_t) page->va
+			& ~((uint64_t) FAULT_AROUND * PGSIZE - 1));
+
+	for (size_t i = 0; i < FAULT_AROUND; i++) {
+		void *va = start + i * PGSIZE;
+		struct page *other;
+		struct frame *frame;
+
+		if (va == page->va)
+			continue;
+		other = spt_find_page(spt, va);
+		if (other == NULL || page_is_zero_fill(other)
+				|| pending_file(other) != file)
+			continue;
+		if (text_frame_claim(other)) {
+			fault_around_cnt++;
+			continue;
+		}
+		frame = vm_try_get_frame();
+		if (frame == NULL || !vm_load_page(other, frame))
+			break;
+		fault_around_cnt++;
+	}
 }
 
 /* Free the page.
@@ -270,17 +819,183 @@ vm_claim_page (void *va) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	/* Program text another process has loaded already is shared. */
+	if (text_frame_claim(page))
+		return true;
+	return vm_load_page (page, vm_get_frame ());
+}
+
+/* Loads PAGE into FRAME, a frame fresh from vm_get_frame() or
+ * vm_try_get_frame(), and maps it.  Frees FRAME on failure. */
+static bool
+vm_load_page (struct page *page, struct frame *frame) {
+	struct frame text;
+	bool is_text = page_text_key(page, &text);
+
+	if (!vm_map_frame(page, frame))
+		return false;
+	/* Anonymous memory starts out zeroed, as the zero page reads. */
+	if (page_is_zero_fill(page) && page->uninit.init == NULL)
+		memset(frame->kva, 0, PGSIZE);
+	if (!swap_in (page, frame->kva)) {
+		vm_unmap_frame(page);
+		return false;
+	}
+
+	/* Only a loaded page may be evicted. */
+	lock_acquire(&frame_lock);
+	frame_table_insert(frame);
+	if (is_text) {
+		frame->text_inode = text.text_inode;
+		frame->text_ofs = text.text_ofs;
+		frame->text_bytes = text.text_bytes;
+		/* The table holds its own reference, so the key cannot be
+		 * reused by another executable while the frame is listed. */
+		if (hash_insert(&text_frames, &frame->text_elem) != NULL)
+			frame->text_inode = NULL;   /* Someone else was faster. */
+		else
+			inode_reopen(frame->text_inode);
+	}
+	lock_release(&frame_lock);
+	return true;
+}
+
+/* Links PAGE to FRAME, a frame fresh from vm_get_frame() or
+ * vm_try_get_frame(), and maps it, for PAGE to be swapped in.
+ * Frees FRAME on failure. */
+static bool
+vm_map_frame (struct page *page, struct frame *frame) {
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_link(frame, page);
+	page->is_needed_to_cow = false;
 
 	/* TODO: Insert page table entry to map page's VA to frame's PA. */
 	if(!pml4_set_page(page->t->pml4, page->va, frame->kva, page->writable)){
 		//USERTODO
+		vm_unmap_frame(page);
+		return false;
+	}
+	return true;
+}
+
+/* Undoes vm_map_frame() on PAGE, freeing its frame. */
+static void
+vm_unmap_frame (struct page *page) {
+	struct frame *frame = page->frame;
+
+	pml4_clear_page(page->t->pml4, page->va);
+	list_remove(&page->pages_elem);
+	page->frame = NULL;
+	frame_free(frame);
+}
+
+/* Swaps PAGE, an anonymous page that is swapped out, back in along
+ * with the swapped out pages that follow it in memory and whose
+ * slots follow its slot, up to SWAP_CLUSTER pages in all.  Pages
+ * swapped out one after another sit in neighbouring slots, so the
+ * cluster comes back in one disk transfer.  As in fault-around, the
+ * pages after PAGE only take frames that are free. */
+static bool
+vm_swap_in_cluster (struct page *page) {
+	struct supplemental_page_table *spt = &page->t->spt;
+	struct page *pages[SWAP_CLUSTER];
+	size_t cnt = 0;
+
+	if (!vm_map_frame(page, vm_get_frame()))
+		return false;
+	pages[cnt++] = page;
+
+	while (cnt < SWAP_CLUSTER) {
+		struct page *other = spt_find_page(spt, page->va + cnt * PGSIZE);
+		struct frame *frame;
+
+		if (other == NULL || VM_TYPE(other->operations->type) != VM_ANON
+				|| other->frame != NULL
+				|| other->anon.swap_idx != page->anon.swap_idx + cnt)
+			break;
+		frame = vm_try_get_frame();
+		if (frame == NULL || !vm_map_frame(other, frame))
+			break;
+		pages[cnt++] = other;
+	}
+
+	if (!anon_swap_in_cluster(pages, cnt)) {
+		for (size_t i = 0; i < cnt; i++)
+			vm_unmap_frame(pages[i]);
+		return false;
+	}
+
+	/* Only a loaded page may be evicted. */
+	lock_acquire(&frame_lock);
+	for (size_t i = 0; i < cnt; i++)
+		frame_table_insert(pages[i]->frame);
+	swap_cluster_cnt += cnt - 1;
+	lock_release(&frame_lock);
+	return true;
+}
+
+/* Returns true if PAGE is a pending anonymous page that starts out
+ * all zeroes: a page of stack, or one of BSS that load_segment()
+ * reads nothing into.  It may be mapped to the zero page
+ * meanwhile. */
+static bool
+page_is_zero_fill (struct page *page) {
+	struct Inform_load_file *ilf = page->uninit.aux;
+
+	if (VM_TYPE(page->operations->type) != VM_UNINIT
+			|| VM_TYPE(page->uninit.type) != VM_ANON)
+		return false;
+	if (page->uninit.init == NULL)
+		return true;
+	return ilf != NULL && ilf->page_read_bytes == 0;
+}
+
+/* If PAGE is a pending read-only page of the executable, stores
+ * where it is loaded from into KEY's TEXT_* members and returns
+ * true.  load_segment() is the only one to give pending anonymous
+ * pages an aux. */
+static bool
+page_text_key (struct page *page, struct frame *key) {
+	struct Inform_load_file *ilf;
+
+	if (VM_TYPE(page->operations->type) != VM_UNINIT || page->writable
+			|| VM_TYPE(page->uninit.type) != VM_ANON || page->uninit.aux == NULL)
+		return false;
+
+	ilf = page->uninit.aux;
+	key->text_inode = file_get_inode(ilf->file);
+	key->text_ofs = ilf->ofs;
+	key->text_bytes = ilf->page_read_bytes;
+	return true;
+}
+
+/* Maps pending text page PAGE to the frame that already holds the
+ * same text, if any, and makes it an anonymous page, as loading it
+ * would have.  Returns false if PAGE has to be loaded. */
+static bool
+text_frame_claim (struct page *page) {
+	struct frame key, *frame;
+	struct hash_elem *e;
+	void *aux = page->uninit.aux;
+
+	if (!page_text_key(page, &key))
+		return false;
+	lock_acquire(&frame_lock);
+	e = hash_find(&text_frames, &key.text_elem);
+	frame = e != NULL ? hash_entry(e, struct frame, text_elem) : NULL;
+	if (frame == NULL || frame->busy
+			|| !pml4_set_page(page->t->pml4, page->va, frame->kva, false)) {
+		lock_release(&frame_lock);
 		return false;
 	}
-	return swap_in (page, frame->kva);
+	page->uninit.page_initializer(page, page->uninit.type, frame->kva);
+	frame_link(frame, page);
+	page->is_needed_to_cow = false;
+	text_share_cnt++;
+	lock_release(&frame_lock);
+
+	free(aux);
+	return true;
 }
 
 /* Initialize new supplemental page table */
@@ -304,65 +1019,104 @@ supplemental_page_table_copy (struct supplemental_page_table *dst,
 		// parent's spt's page
 
 		struct page *page = hash_entry(hash_cur(&iter), struct page, spt_elem);
+		struct page *child;
+		struct frame *frame;
 
-		if (VM_TYPE(page->operations->type) == VM_UNINIT) {
-			
-			if (!vm_alloc_page_with_initializer(page->type, page->va, page->writable, page->uninit.init, page->uninit.aux)) {
-				// errore handling USERTODO 
-				return false;
-			}
+		child = page_clone(dst, page);
+		if (child == NULL)
+			return false;
+
+		// still pending: the child loads it on its own first fault
+		if (VM_TYPE(page->operations->type) == VM_UNINIT)
+			continue;
+
+		lock_acquire(&frame_lock);
+		frame = page_pin_frame(page);
+		lock_release(&frame_lock);
+
+		if (frame == NULL) {
+			// swapped out: share the slot, or read the file again
+			if (VM_TYPE(page->operations->type) == VM_ANON)
+				anon_swap_share(child, page->anon.swap_idx);
+			continue;
 		}
-		
-		else if (VM_TYPE(page->operations->type) == VM_ANON) {
-			if (!vm_alloc_page_with_initializer(page->type, page->va, page->writable, 0, 0)) {
-				// errore handling USERTODO 
-				return false;
-			} 
+
+		/* Mapping it read-only drops the dirty bit, so write a dirty
+		 * file-backed page back first. */
+		if (VM_TYPE(page->operations->type) == VM_FILE)
+			file_backed_writeback(page);
+
+		lock_acquire(&frame_lock);
+		if (page->writable) {
+			pml4_set_page(page->t->pml4, page->va, frame->kva, false);
+			page->is_needed_to_cow = true;
+			child->is_needed_to_cow = true;
 		}
-		else if (VM_TYPE(page->operations->type) == VM_FILE) {
-			struct Inform_mmap_file *imf = (struct Inform_mmap_file *)malloc(sizeof(struct Inform_mmap_file));
-			if (imf == NULL) return false;
-			struct file_page *file_page = &page->file;
-			
-			imf->file = file_page->file;
-			imf->mmap_addr = file_page->mmap_addr;
-			imf->number_of_page = file_page->number_of_pages;
-			imf->ofs = file_page->file_offset;
-			imf->page_read_bytes = file_page->length;
-			imf->page_zero_bytes = PGSIZE - imf->page_read_bytes;
-
-			if (!vm_alloc_page_with_initializer(page->type, page->va, page->writable, lazy_load_segment_file, imf)) {
-				// errore handling USERTODO 
-				free(imf);
-				return false;
-			}
+		if (!pml4_set_page(child->t->pml4, child->va, frame->kva, false)) {
+			frame_unpin(frame);
+			lock_release(&frame_lock);
+			return false;
 		}
+		frame_link(frame, child);
+		frame_unpin(frame);
+		lock_release(&frame_lock);
+	}
+	return true;
+}
 
-		struct page *child = spt_find_page(dst,page->va);
-		
-		if (!vm_do_claim_page(child)) {
-			// errore handling USERTODO
-			return false;
-		} 
+/* Adds a copy of SRC, another thread's page, to the current
+ * thread's DST, without any frame. */
+static struct page *
+page_clone (struct supplemental_page_table *dst, struct page *src) {
+	struct page *page = malloc(sizeof *page);
 
-		if (page->frame == NULL)
-		{
-			vm_do_claim_page(page);
-		}
+	if (page == NULL)
+		return NULL;
+	memcpy(page, src, sizeof *page);
+	page->t = thread_current();
+	page->frame = NULL;
+	page->is_needed_to_cow = false;
+	if (VM_TYPE(page->operations->type) == VM_ANON)
+		page->anon.swap_idx = -1;
+	if (VM_TYPE(page->operations->type) == VM_UNINIT
+			&& !uninit_aux_dup(page, src)) {
+		free(page);
+		return NULL;
+	}
+	if (!spt_insert_page(dst, page)) {
+		if (VM_TYPE(page->operations->type) == VM_UNINIT)
+			free(page->uninit.aux);
+		free(page);
+		return NULL;
+	}
+	return page;
+}
+
+/* Gives PAGE, a pending page cloned from SRC, its own copy of
+ * SRC's lazy loading information, since the initializer frees it.
+ * A segment of the executable is read through the current thread's
+ * own handle on it.  Returns false if out of memory. */
+static bool
+uninit_aux_dup (struct page *page, struct page *src) {
+	void *aux = src->uninit.aux;
+	size_t size;
+
+	if (aux == NULL)
+		return true;
 
-		memcpy(child->frame->kva, page->frame->kva, PGSIZE);
+	if (page->uninit.init == lazy_load_segment_file)
+		size = sizeof(struct Inform_mmap_file);
+	else
+		size = sizeof(struct Inform_load_file);
+	page->uninit.aux = malloc(size);
+	if (page->uninit.aux == NULL)
+		return false;
+	memcpy(page->uninit.aux, aux, size);
 
-		// for COW
-		// if (page->frame == NULL) {
-		// 	if (!vm_do_claim_page(page)) {
-		// 		// error hanlding
-		// 	}
-		// }
-		// child->frame = page->frame;
-		// if (!pml4_set_page(child->t->pml4, child->va, child->frame->kva, child->writable)){
-		// 	//USERTODO
-		// 	return false;
-		// }
+	if (page->uninit.init != lazy_load_segment_file) {
+		struct Inform_load_file *ilf = page->uninit.aux;
+		if (ilf->file == src->t->load_file)
+			ilf->file = page->t->load_file;
 	}
 	return true;
 }
@@ -376,12 +1130,169 @@ supplemental_page_table_kill (struct supplemental_page_table *spt) {
 		return;
 
 	struct hash_iterator iter;
+
+	/* Take the frames out of the frame table first, waiting out any
+	 * eviction in progress, so that nobody else touches the pages.
+	 * Frames shared with other processes stay with them. */
+	lock_acquire(&frame_lock);
 	hash_first(&iter, &spt->pages);
+	while(hash_next(&iter)) {
+		struct page *page = hash_entry(hash_cur(&iter), struct page, spt_elem);
+		struct frame *frame = page_pin_frame(page);
+
+		if (frame == NULL)
+			continue;
+		if (list_size(&frame->pages) > 1) {
+			/* destroy() will not see the frame any more: write it back
+			 * now, while our mapping is still in place. */
+			if (VM_TYPE(page->operations->type) == VM_FILE) {
+				lock_release(&frame_lock);
+				file_backed_writeback(page);
+				lock_acquire(&frame_lock);
+			}
+			frame_unlink(frame, page);
+			pml4_clear_page(page->t->pml4, page->va);
+		} else
+			frame_table_remove(frame);
+		frame_unpin(frame);
+	}
+	lock_release(&frame_lock);
 
+	hash_first(&iter, &spt->pages);
 	while(hash_next(&iter)) {
 		struct page *page = hash_entry(hash_cur(&iter), struct page, spt_elem);
 		destroy(page);
 	}
+	hash_clear(&spt->pages, spt_page_free);
+}
+
+/* Frees the frame of the page in E, if any, and the page itself.
+ * The page must have been destroyed already. */
+static void
+spt_page_free (struct hash_elem *e, void *aux UNUSED) {
+	struct page *page = hash_entry(e, struct page, spt_elem);
+	struct frame *frame = page->frame;
+
+	/* Also unmaps the zero page, which pml4_destroy() would free. */
+	pml4_clear_page(page->t->pml4, page->va);
+	if (frame != NULL)
+		frame_free(frame);
+	free(page);
+}
+
+/* Free frames kswapd keeps in reserve: an eighth of all frames, up
+ * to KSWAPD_HIGH. */
+static size_t
+high_watermark (void) {
+	size_t high = frame_total / 8;
+	return high < KSWAPD_HIGH ? high : KSWAPD_HIGH;
+}
+
+/* Free frames below which kswapd is woken up. */
+static size_t
+low_watermark (void) {
+	return (high_watermark() + 3) / 4;
+}
+
+/* Cleans dirty file-backed pages among the next KSWAPD_CLEAN frames
+ * the clock will look at, so that evicting them needs no write.
+ * Must be called with FRAME_LOCK held. */
+static void
+kswapd_clean (void) {
+	struct list_elem *e = clock_hand;
+
+	for (int i = 0; i < KSWAPD_CLEAN && !list_empty(&frame_table); i++) {
+		struct frame *frame;
+		struct page *page;
+
+		if (e == list_end(&frame_table))
+			e = list_begin(&frame_table);
+		frame = list_entry(e, struct frame, ft_elem);
+		page = frame->page;
+		if (frame->busy || VM_TYPE(page->operations->type) != VM_FILE
+				|| !vm_frame_test_dirty(frame, false)) {
+			e = list_next(e);
+			continue;
+		}
+
+		/* Stays in the table but is skipped while EVICTING is set. */
+		frame->busy = true;
+		lock_release(&frame_lock);
+		file_backed_writeback(page);
+		lock_acquire(&frame_lock);
+		frame->busy = false;
+		cond_broadcast(&busy_done, &frame_lock);
+		e = list_next(&frame->ft_elem);
+	}
+}
+
+/* Background reclaimer.  When a page fault finds the free frame
+ * pool low, evicts frames in batches until the pool reaches the
+ * high watermark, so that later faults need not wait for a
+ * swap-out. */
+static void
+kswapd (void *aux UNUSED) {
+	lock_acquire(&frame_lock);
+	for (;;) {
+		while (!reclaim_wanted)
+			cond_wait(&kswapd_cond, &frame_lock);
+
+		while (free_cnt < high_watermark()) {
+			struct frame *batch[KSWAPD_BATCH];
+			size_t cnt = 0;
+
+			while (cnt < KSWAPD_BATCH && free_cnt + cnt < high_watermark()
+					&& (batch[cnt] = vm_get_victim()) != NULL) {
+				batch[cnt]->busy = true;
+				cnt++;
+			}
+			if (cnt == 0)
+				break;
+			lock_release(&frame_lock);
+
+			/* Let the swap writes of the batch merge. */
+			bool success[KSWAPD_BATCH];
+			anon_swap_plug();
+			for (size_t i = 0; i < cnt; i++)
+				success[i] = frame_swap_out(batch[i]);
+			anon_swap_unplug();
+
+			lock_acquire(&frame_lock);
+			for (size_t i = 0; i < cnt; i++) {
+				batch[i]->busy = false;
+				if (success[i]) {
+					list_push_back(&free_frames, &batch[i]->ft_elem);
+					free_cnt++;
+					evict_cnt++;
+				} else
+					frame_table_insert(batch[i]);
+			}
+			cond_broadcast(&busy_done, &frame_lock);
+
+			/* Out of swap, most likely; let faults evict directly. */
+			bool progress = false;
+			for (size_t i = 0; i < cnt; i++)
+				progress = progress || success[i];
+			if (!progress)
+				break;
+		}
+		kswapd_clean();
+		reclaim_wanted = false;
+	}
+}
+
+/* Prints VM statistics. */
+void
+vm_print_stats (void) {
+	printf ("VM: %lld page faults, %lld evictions (%lld direct), "
+			"%zu frames free (%s)\n", fault_cnt, evict_cnt, direct_evict_cnt,
+			free_cnt, vm_evict_policy == VM_EVICT_FIFO ? "fifo" : "clock");
+	printf ("VM: %lld text pages shared, %zu cached, "
+			"%lld pages faulted around, %lld swapped in around, "
+			"%lld zero pages mapped\n",
+			text_share_cnt, hash_size(&text_frames), fault_around_cnt,
+			swap_cluster_cnt, zero_map_cnt);
+	zswap_print_stats ();
 }
 
 // addition for spt hash table
@@ -395,6 +1306,20 @@ bool page_less_func (const struct hash_elem *a, const struct hash_elem *b, void
 
 	return page_a->va < page_b->va;
 }
+static uint64_t text_hash_func (const struct hash_elem *e, void *aux UNUSED){
+	const struct frame *f = hash_entry(e, struct frame, text_elem);
+	return hash_bytes(&f->text_inode, sizeof(f->text_inode)) ^ hash_int(f->text_ofs);
+}
+static bool text_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED){
+	const struct frame *fa = hash_entry(a, struct frame, text_elem);
+	const struct frame *fb = hash_entry(b, struct frame, text_elem);
+
+	if (fa->text_inode != fb->text_inode)
+		return fa->text_inode < fb->text_inode;
+	if (fa->text_ofs != fb->text_ofs)
+		return fa->text_ofs < fb->text_ofs;
+	return fa->text_bytes < fb->text_bytes;
+}
 struct page* page_lookup (struct supplemental_page_table *spt, const void *address) {
   struct page p;
   struct hash_elem *e;
@@ -0,0 +1,325 @@
+/* zswap.c: Compressed in-memory tier in front of the swap disk.
+ *
+ * anon_swap_out() offers each page it swaps out to zswap_store()
+ * first.  A page that compresses well is kept in kernel memory,
+ * under its swap slot, and never reaches the disk; the others are
+ * written to the slot as before.  Once the pool is full, its oldest
+ * pages are written back to their slots to make room, with
+ * zswap_evict().  Zeroed buffers and sparse arrays, which make up
+ * much of what gets swapped, shrink to a few dozen bytes. */
+
+#include "vm/zswap.h"
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A compressed page. */
+struct zswap_entry {
+	struct list_elem elem;      /* In STORE_ORDER. */
+	size_t slot;                /* Swap slot it is kept under. */
+	size_t size;                /* Bytes in DATA. */
+	uint8_t data[];             /* lz_compress() output. */
+};
+
+/* Largest compressed page kept, header included: the largest block
+ * malloc() carves out of a page rather than giving a page of its
+ * own.  Pages that do not shrink to a quarter go to the disk. */
+#define ZSWAP_ENTRY_MAX 1024
+
+/* Memory the compressed pages may take in all, counted as what
+ * malloc() really takes for them: see zswap_charge(). */
+#define ZSWAP_POOL_PAGES 64
+#define ZSWAP_POOL_BYTES (ZSWAP_POOL_PAGES * PGSIZE)
+
+static struct zswap_entry **entries;   /* By swap slot, or NULL. */
+static size_t entry_cnt;
+static size_t pool_bytes;              /* Memory taken by ENTRIES. */
+static struct list store_order;        /* ENTRIES, oldest first. */
+
+/* Protects ENTRIES, POOL_BYTES, STORE_ORDER and the statistics.
+ * Compression happens outside it. */
+static struct lock zswap_lock;
+
+/* Statistics. */
+static long long store_cnt, reject_cnt, full_cnt, load_cnt, evict_cnt;
+
+/* The compressed format is a sequence of runs, each starting with a
+ * control byte C.  If C < 0x80, C + 1 literal bytes follow.
+ * Otherwise the run repeats (C & 0x7f) + LZ_MIN_MATCH bytes from the
+ * output, starting the 16-bit little-endian offset that follows
+ * back from the current position; the copy may overlap itself. */
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (0x7f + LZ_MIN_MATCH)
+#define LZ_MAX_LITERAL 0x80
+#define LZ_HASH_BITS 10
+
+/* Working memory of one zswap_store(), too big for a kernel stack,
+ * so each call takes a page for it. */
+struct lz_scratch {
+	/* Where each hash of LZ_MIN_MATCH bytes was last seen, plus 1. */
+	uint16_t table[1 << LZ_HASH_BITS];
+	/* Output of lz_compress(). */
+	uint8_t buf[ZSWAP_ENTRY_MAX - sizeof (struct zswap_entry)];
+};
+
+static size_t zswap_charge (size_t size);
+static size_t lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_max,
+		uint16_t *table);
+static bool lz_decompress (const uint8_t *src, size_t size, uint8_t *dst);
+
+/* Sets up the tier for a swap disk of SLOT_CNT slots. */
+void
+zswap_init (size_t slot_cnt) {
+	entries = calloc(slot_cnt, sizeof *entries);
+	if (entries == NULL)
+		PANIC("zswap init failed");
+	entry_cnt = slot_cnt;
+	list_init(&store_order);
+	lock_init(&zswap_lock);
+}
+
+/* Keeps a compressed copy of the page at KVA under swap slot SLOT.
+ * Returns false, keeping nothing, if the page does not compress
+ * well enough or the pool is full: it has to go to the disk. */
+bool
+zswap_store (size_t slot, const void *kva) {
+	struct lz_scratch *scratch;
+	struct zswap_entry *e = NULL;
+	size_t size;
+
+	ASSERT(slot < entry_cnt);
+
+	scratch = palloc_get_page(0);
+	if (scratch == NULL)
+		return false;
+	size = lz_compress(kva, scratch->buf, sizeof scratch->buf, scratch->table);
+	if (size != 0) {
+		e = malloc(sizeof *e + size);
+		if (e != NULL) {
+			e->slot = slot;
+			e->size = size;
+			memcpy(e->data, scratch->buf, size);
+		}
+	}
+	palloc_free_page(scratch);
+
+	lock_acquire(&zswap_lock);
+	ASSERT(entries[slot] == NULL);
+	if (size == 0)
+		reject_cnt++;
+	else if (e != NULL
+			&& pool_bytes + zswap_charge(sizeof *e + size) > ZSWAP_POOL_BYTES) {
+		full_cnt++;
+		free(e);
+		e = NULL;
+	} else if (e != NULL) {
+		entries[slot] = e;
+		list_push_back(&store_order, &e->elem);
+		pool_bytes += zswap_charge(sizeof *e + size);
+		store_cnt++;
+	}
+	lock_release(&zswap_lock);
+	return e != NULL;
+}
+
+/* Returns true if the pool may not have room for another page.
+ * Writing back its oldest pages with zswap_evict() makes room. */
+bool
+zswap_full (void) {
+	bool full;
+
+	lock_acquire(&zswap_lock);
+	full = pool_bytes + zswap_charge(ZSWAP_ENTRY_MAX) > ZSWAP_POOL_BYTES;
+	lock_release(&zswap_lock);
+	return full;
+}
+
+/* Takes the oldest page out of the pool, decompressing it into KVA
+ * and storing its slot in *SLOT, for the caller to write it there.
+ * Returns false if the pool is empty.  Once this returns, loads of
+ * the slot miss, so the caller must make sure that its readers find
+ * the page until the write is done. */
+bool
+zswap_evict (size_t *slot, void *kva) {
+	struct zswap_entry *e;
+
+	lock_acquire(&zswap_lock);
+	if (list_empty(&store_order)) {
+		lock_release(&zswap_lock);
+		return false;
+	}
+	e = list_entry(list_pop_front(&store_order), struct zswap_entry, elem);
+	if (!lz_decompress(e->data, e->size, kva))
+		PANIC("zswap: slot %zu is corrupt", e->slot);
+	entries[e->slot] = NULL;
+	pool_bytes -= zswap_charge(sizeof *e + e->size);
+	evict_cnt++;
+	lock_release(&zswap_lock);
+
+	*slot = e->slot;
+	free(e);
+	return true;
+}
+
+/* Decompresses the page kept under SLOT into KVA.  Returns false if
+ * there is none: the page is on the disk.  The copy stays until
+ * zswap_drop(), since the slot may be shared. */
+bool
+zswap_load (size_t slot, void *kva) {
+	struct zswap_entry *e;
+
+	ASSERT(slot < entry_cnt);
+
+	lock_acquire(&zswap_lock);
+	e = entries[slot];
+	if (e == NULL) {
+		lock_release(&zswap_lock);
+		return false;
+	}
+	if (!lz_decompress(e->data, e->size, kva))
+		PANIC("zswap: slot %zu is corrupt", slot);
+	load_cnt++;
+	lock_release(&zswap_lock);
+	return true;
+}
+
+/* Frees the page kept under SLOT, if any, as the slot is freed. */
+void
+zswap_drop (size_t slot) {
+	struct zswap_entry *e;
+
+	ASSERT(slot < entry_cnt);
+
+	lock_acquire(&zswap_lock);
+	e = entries[slot];
+	entries[slot] = NULL;
+	if (e != NULL) {
+		list_remove(&e->elem);
+		pool_bytes -= zswap_charge(sizeof *e + e->size);
+	}
+	lock_release(&zswap_lock);
+	free(e);
+}
+
+/* Prints zswap statistics. */
+void
+zswap_print_stats (void) {
+	printf ("zswap: %lld pages stored, %lld loaded, %lld rejected, "
+			"%lld past a full pool, %lld written back, %zu bytes in use\n",
+			store_cnt, load_cnt, reject_cnt, full_cnt, evict_cnt, pool_bytes);
+}
+
+/* Returns the memory malloc() takes for a block of SIZE bytes, at
+ * most ZSWAP_ENTRY_MAX.  It rounds SIZE up to a power of two, at
+ * least 16, and carves blocks of that size out of pages that also
+ * hold a header, which leaves the rest of each page unused. */
+static size_t
+zswap_charge (size_t size) {
+	size_t block = 16;
+
+	ASSERT(size <= ZSWAP_ENTRY_MAX);
+	while (block < size)
+		block *= 2;
+	return PGSIZE / ((PGSIZE - 1) / block);
+}
+
+/* Returns the index into LZ_TABLE for the LZ_MIN_MATCH bytes at P. */
+static size_t
+lz_hash (const uint8_t *p) {
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends the CNT literal bytes at SRC to DST, which holds *OP of
+ * at most DST_MAX bytes.  Returns false if they do not fit. */
+static bool
+lz_literals (const uint8_t *src, size_t cnt, uint8_t *dst, size_t *op,
+		size_t dst_max) {
+	while (cnt > 0) {
+		size_t n = cnt < LZ_MAX_LITERAL ? cnt : LZ_MAX_LITERAL;
+
+		if (*op + 1 + n > dst_max)
+			return false;
+		dst[(*op)++] = n - 1;
+		memcpy(dst + *op, src, n);
+		*op += n;
+		src += n;
+		cnt -= n;
+	}
+	return true;
+}
+
+/* Compresses the page at SRC into DST, of DST_MAX bytes, with a
+ * greedy LZ77 pass that remembers the last place each 3-byte string
+ * was seen, in TABLE, of 1 << LZ_HASH_BITS entries.  Returns the
+ * compressed size, or 0 if it would exceed DST_MAX. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_max,
+		uint16_t *table) {
+	size_t ip = 0, op = 0, lit = 0;
+
+	memset(table, 0, sizeof *table << LZ_HASH_BITS);
+	while (ip + LZ_MIN_MATCH <= PGSIZE) {
+		size_t h = lz_hash(src + ip);
+		size_t m = table[h];
+		size_t len;
+
+		table[h] = ip + 1;
+		if (m == 0 || memcmp(src + m - 1, src + ip, LZ_MIN_MATCH) != 0) {
+			ip++;
+			continue;
+		}
+		m--;
+		for (len = LZ_MIN_MATCH; ip + len < PGSIZE && len < LZ_MAX_MATCH
+				&& src[m + len] == src[ip + len]; len++)
+			continue;
+
+		if (!lz_literals(src + lit, ip - lit, dst, &op, dst_max)
+				|| op + 3 > dst_max)
+			return 0;
+		dst[op++] = 0x80 | (len - LZ_MIN_MATCH);
+		dst[op++] = (ip - m) & 0xff;
+		dst[op++] = (ip - m) >> 8;
+		ip += len;
+		lit = ip;
+	}
+	if (!lz_literals(src + lit, PGSIZE - lit, dst, &op, dst_max))
+		return 0;
+	return op;
+}
+
+/* Decompresses the SIZE bytes at SRC, from lz_compress(), into the
+ * page at DST.  Returns false if they are not a valid page. */
+static bool
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst) {
+	size_t ip = 0, op = 0;
+
+	while (ip < size) {
+		uint8_t c = src[ip++];
+
+		if (c < 0x80) {
+			size_t n = c + 1;
+			if (ip + n > size || op + n > PGSIZE)
+				return false;
+			memcpy(dst + op, src + ip, n);
+			ip += n;
+			op += n;
+		} else {
+			size_t n = (c & 0x7f) + LZ_MIN_MATCH, ofs;
+			if (ip + 2 > size)
+				return false;
+			ofs = src[ip] | (src[ip + 1] << 8);
+			ip += 2;
+			if (ofs == 0 || ofs > op || op + n > PGSIZE)
+				return false;
+			for (size_t i = 0; i < n; i++, op++)
+				dst[op] = dst[op - ofs];
+		}
+	}
+	return op == PGSIZE;
+}